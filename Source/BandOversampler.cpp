@@ -0,0 +1,178 @@
+/*
+  ==============================================================================
+
+    BandOversampler.cpp
+    Created: 19 Oct 2026 10:12:51am
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#include "BandOversampler.h"
+
+void BandOversampler::prepare(int numChannels, int maxBlockSize) {
+    mNumChannels = numChannels;
+    for (int index = 0; index < 3; index++)
+        mOversample[index].prepare(index + 1, numChannels, maxBlockSize);
+
+    mFadeBuffer.setSize(numChannels, maxBlockSize);
+    for (auto& histories : mAlignHistory)
+        histories.assign(numChannels, {});
+    reset();
+}
+
+void BandOversampler::reset() {
+    for (auto& oversampler : mOversample)
+        oversampler.reset();
+    for (auto& histories : mAlignHistory) {
+        for (auto& history : histories)
+            history.fill(0.0f);
+    }
+
+    //nothing to fade from after a reset
+    mPreviousFactor = mFactor;
+    mPreviousAlignLatency = mAlignLatency;
+}
+
+void BandOversampler::setFactor(int newFactor) {
+    if (newFactor == mFactor)
+        return;
+
+    //new factor starts from clean state, the crossfade hides the warm up
+    //don't reset if we are going straight back to the factor still playing
+    if (newFactor != mPreviousFactor) {
+        if (newFactor > 1)
+            mOversample[factorToIndex(newFactor)].reset();
+        for (auto& history : mAlignHistory[factorToRateIndex(newFactor)])
+            history.fill(0.0f);
+    }
+
+    mFactor = newFactor;
+}
+
+void BandOversampler::setAlignment(int latencyInSamples) {
+    mAlignLatency = juce::jlimit(0, maxAlignDelay, latencyInSamples);
+}
+
+void BandOversampler::syncToFirstChannel() {
+    for (auto& oversampler : mOversample)
+        oversampler.syncToFirstChannel();
+    for (auto& histories : mAlignHistory) {
+        for (auto& history : histories)
+            history = histories.front();
+    }
+}
+
+void BandOversampler::process(juce::AudioBuffer<float>& buffer, int numChannels, int numSamples, DistortionProcessor* shaper) {
+    numChannels = std::min({ numChannels, buffer.getNumChannels(), mNumChannels });
+    bool factorFading = mPreviousFactor != mFactor;
+    bool fading = factorFading || mPreviousAlignLatency != mAlignLatency;
+
+    if (factorFading) {
+        //old factor runs on a copy, with a copy of the shaper
+        //so the shaper state only moves forward once
+        DistortionProcessor fadeShaper;
+        if (shaper != nullptr)
+            fadeShaper = *shaper;
+
+        for (int channel = 0; channel < numChannels; channel++)
+            mFadeBuffer.copyFrom(channel, 0, buffer, channel, 0, numSamples);
+        processFactor(mPreviousFactor, mFadeBuffer, numChannels, numSamples,
+            shaper != nullptr ? &fadeShaper : nullptr);
+        align(mPreviousFactor, getAlignDelay(mPreviousFactor, mPreviousAlignLatency), mFadeBuffer, numChannels, numSamples);
+    }
+
+    processFactor(mFactor, buffer, numChannels, numSamples, shaper);
+
+    //same factor with a new alignment, the old delay is one more tap on the same history
+    if (fading && !factorFading) {
+        auto& histories = mAlignHistory[factorToRateIndex(mFactor)];
+        int previousDelay = getAlignDelay(mFactor, mPreviousAlignLatency);
+        for (int channel = 0; channel < numChannels; channel++)
+            readDelayed(histories[channel], buffer.getReadPointer(channel), mFadeBuffer.getWritePointer(channel), numSamples, previousDelay);
+    }
+    align(mFactor, getAlignDelay(mFactor, mAlignLatency), buffer, numChannels, numSamples);
+
+    if (fading) {
+        for (int channel = 0; channel < numChannels; channel++) {
+            buffer.applyGainRamp(channel, 0, numSamples, 0.0f, 1.0f);
+            buffer.addFromWithRamp(channel, 0, mFadeBuffer.getReadPointer(channel), numSamples, 1.0f, 0.0f);
+        }
+
+        mPreviousFactor = mFactor;
+        mPreviousAlignLatency = mAlignLatency;
+    }
+}
+
+void BandOversampler::processFactor(int factor, juce::AudioBuffer<float>& buffer, int numChannels, int numSamples, DistortionProcessor* shaper) {
+    if (factor <= 1) {
+        if (shaper != nullptr) {
+            for (int channel = 0; channel < numChannels; channel++)
+                shaper->processBlock(buffer.getWritePointer(channel), numSamples, 1, channel);
+        }
+        return;
+    }
+
+    //all channels go up together, interleaved
+    auto& oversampler = mOversample[factorToIndex(factor)];
+    float* samples = oversampler.processSamplesUp(buffer.getArrayOfReadPointers(), numChannels, numSamples);
+
+    //every interleaved frame of the upsampled buffer in one run, each channel on its own dc blocker
+    if (shaper != nullptr)
+        shaper->processBlock(samples, numSamples * factor, numChannels);
+
+    oversampler.processSamplesDown(buffer.getArrayOfWritePointers(), numChannels, numSamples);
+}
+
+int BandOversampler::getLatencyInSamples() const {
+    return getFactorLatency(mFactor) + getAlignDelay(mFactor, mAlignLatency);
+}
+
+int BandOversampler::getFactorLatency(int factor) const {
+    if (factor <= 1)
+        return 0;
+    return (int)std::round(mOversample[factorToIndex(factor)].getLatencyInSamples());
+}
+
+int BandOversampler::getAlignDelay(int factor, int alignLatency) const {
+    return juce::jlimit(0, maxAlignDelay, alignLatency - getFactorLatency(factor));
+}
+
+//delays the block in place, the history is updated even with no delay
+//so a later, longer delay has the samples it needs
+void BandOversampler::align(int factor, int delay, juce::AudioBuffer<float>& buffer, int numChannels, int numSamples) {
+    auto& histories = mAlignHistory[factorToRateIndex(factor)];
+    for (int channel = 0; channel < numChannels; channel++) {
+        auto& history = histories[channel];
+        float* data = buffer.getWritePointer(channel);
+        DelayHistory previous = history;
+
+        if (numSamples >= maxAlignDelay) {
+            std::copy(data + numSamples - maxAlignDelay, data + numSamples, history.begin());
+        }
+        else {
+            std::copy(history.begin() + numSamples, history.end(), history.begin());
+            std::copy(data, data + numSamples, history.end() - numSamples);
+        }
+
+        if (delay > 0)
+            readDelayed(previous, data, data, numSamples, delay);
+    }
+}
+
+//backwards, so output may be the input
+void BandOversampler::readDelayed(const DelayHistory& history, const float* input, float* output, int numSamples, int delay) {
+    for (int i = numSamples - 1; i >= 0; i--)
+        output[i] = i >= delay ? input[i - delay] : history[maxAlignDelay - delay + i];
+}
+
+int BandOversampler::factorToIndex(int factor) {
+    if (factor == 2) return 0;
+    if (factor == 4) return 1;
+    return 2;
+}
+
+//0 = 1x, 1 = 2x, 2 = 4x, 3 = 8x
+int BandOversampler::factorToRateIndex(int factor) {
+    return factor <= 1 ? 0 : factorToIndex(factor) + 1;
+}
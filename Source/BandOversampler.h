@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    BandOversampler.h
+    Created: 19 Oct 2026 10:12:37am
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "DistortionProcessor.h"
+#include "HalfbandOversampler.h"
+
+//oversampler for one band (or the linear path)
+//every factor is allocated up front so switching on the audio thread never allocates
+class BandOversampler {
+public:
+    void prepare(int numChannels, int maxBlockSize);
+    void reset();
+
+    //1 = "Off", 2, 4, 8
+    void setFactor(int newFactor);
+    int getFactor() const { return mFactor; }
+    //latency of the current factor in host samples, rounded, including the alignment delay
+    int getLatencyInSamples() const;
+    //latency of any factor without the alignment delay, what setAlignment needs to line up with it
+    int getFactorLatency(int factor) const;
+
+    //a band running below the other paths' factor is delayed to this latency
+    //so it lines up with them, changes are crossfaded like a factor change
+    static constexpr int maxAlignDelay = 16;
+    void setAlignment(int latencyInSamples);
+
+    //shapes the first numChannels of the buffer in place at the current factor
+    //shaper is nullptr for the linear path (up and down only)
+    //after a factor change the old and new factor are crossfaded over the block
+    void process(juce::AudioBuffer<float>& buffer, int numChannels, int numSamples, DistortionProcessor* shaper);
+    //copies the first channel's state into every other channel
+    void syncToFirstChannel();
+
+private:
+    void processFactor(int factor, juce::AudioBuffer<float>& buffer, int numChannels, int numSamples, DistortionProcessor* shaper);
+    static int factorToIndex(int factor);
+    int getAlignDelay(int factor, int alignLatency) const;
+
+    //alignment delay, one history per factor since the old and new factor both run while fading
+    //newest sample last
+    using DelayHistory = std::array<float, maxAlignDelay>;
+    std::vector<DelayHistory> mAlignHistory[4];
+    int mAlignLatency = 0;
+    int mPreviousAlignLatency = 0;
+    static int factorToRateIndex(int factor);
+    void align(int factor, int delay, juce::AudioBuffer<float>& buffer, int numChannels, int numSamples);
+    static void readDelayed(const DelayHistory& history, const float* input, float* output, int numSamples, int delay);
+
+    //one multichannel halfband cascade per factor, 0 = 2x, 1 = 4x, 2 = 8x
+    HalfbandOversampler mOversample[3];
+    int mNumChannels = 0;
+
+    //copy of the block for the fading out factor
+    juce::AudioBuffer<float> mFadeBuffer;
+
+    int mFactor = 1;
+    int mPreviousFactor = 1;
+};
@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    BandWorkerPool.cpp
+    Created: 19 Oct 2026 4:05:32pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#include "BandWorkerPool.h"
+
+BandWorkerPool::~BandWorkerPool() {
+    stop();
+}
+
+void BandWorkerPool::start(int numWorkers) {
+    stop();
+
+    for (int index = 0; index < numWorkers; index++) {
+        mWorkers.push_back(std::make_unique<Worker>());
+        auto& worker = *mWorkers.back();
+        worker.thread = std::thread([this, &worker] { workerLoop(worker); });
+    }
+}
+
+void BandWorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mParkMutex);
+        mExit.store(true);
+    }
+    mParkCondition.notify_all();
+
+    for (auto& worker : mWorkers)
+        worker->thread.join();
+    mWorkers.clear();
+
+    mExit.store(false);
+}
+
+std::uint64_t BandWorkerPool::pack(std::uint32_t generation, int numItems, int nextItem) {
+    return ((std::uint64_t)generation << 32) | ((std::uint64_t)(numItems & 0xffff) << 16) | (std::uint64_t)(nextItem & 0xffff);
+}
+
+void BandWorkerPool::runItems(int numItems, ItemFunction function, void* context) {
+    if (numItems <= 0)
+        return;
+
+    //nothing to share, don't pay for the handoff
+    if (mWorkers.empty() || numItems == 1) {
+        for (int item = 0; item < numItems; item++)
+            function(context, item);
+        return;
+    }
+
+    mFunction = function;
+    mContext = context;
+    mItemsDone.store(0, std::memory_order_relaxed);
+
+    //publishing the new generation hands the run to whoever is spinning
+    auto generation = (std::uint32_t)(mWork.load(std::memory_order_relaxed) >> 32) + 1;
+    mWork.store(pack(generation, numItems, 0));
+
+    //parked workers need a wake up, the lock only gets taken when one is actually asleep
+    bool anyParked = false;
+    for (auto& worker : mWorkers)
+        anyParked = anyParked || worker->parked.load();
+    if (anyParked) {
+        { std::lock_guard<std::mutex> lock(mParkMutex); }
+        mParkCondition.notify_all();
+    }
+
+    //the calling thread works too
+    takeItems(generation);
+
+    while (mItemsDone.load(std::memory_order_acquire) < numItems)
+        std::this_thread::yield();
+}
+
+void BandWorkerPool::takeItems(std::uint32_t generation) {
+    auto work = mWork.load(std::memory_order_acquire);
+    while (true) {
+        if ((std::uint32_t)(work >> 32) != generation)
+            return;
+        int numItems = (int)((work >> 16) & 0xffff);
+        int item = (int)(work & 0xffff);
+        if (item >= numItems)
+            return;
+
+        //on failure 'work' is reloaded and checked again
+        if (mWork.compare_exchange_weak(work, work + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            mFunction(mContext, item);
+            mItemsDone.fetch_add(1, std::memory_order_release);
+            work++;
+        }
+    }
+}
+
+void BandWorkerPool::workerLoop(Worker& worker) {
+    auto seen = (std::uint32_t)(mWork.load(std::memory_order_acquire) >> 32);
+
+    while (!mExit.load()) {
+        auto generation = seen;
+        for (int i = 0; i < spinIterations && generation == seen; i++) {
+            generation = (std::uint32_t)(mWork.load(std::memory_order_acquire) >> 32);
+            if (generation == seen)
+                std::this_thread::yield();
+        }
+
+        if (generation == seen) {
+            //nothing came, sleep until the next run or stop()
+            std::unique_lock<std::mutex> lock(mParkMutex);
+            worker.parked.store(true);
+            mParkCondition.wait(lock, [this, seen] {
+                return mExit.load() || (std::uint32_t)(mWork.load() >> 32) != seen;
+            });
+            worker.parked.store(false);
+            if (mExit.load())
+                return;
+            generation = (std::uint32_t)(mWork.load(std::memory_order_acquire) >> 32);
+        }
+
+        seen = generation;
+        takeItems(generation);
+    }
+}
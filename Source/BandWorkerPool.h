@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    BandWorkerPool.h
+    Created: 19 Oct 2026 4:05:18pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//small persistent pool that runs the independent items of one block side by side
+//the calling thread takes items too, so a run with no workers is just a serial loop
+//items are claimed through one lock-free word, idle threads grab whatever is left
+//workers spin briefly between runs and park when nothing comes
+class BandWorkerPool {
+public:
+    BandWorkerPool() = default;
+    ~BandWorkerPool();
+
+    //not realtime safe, message thread only
+    void start(int numWorkers);
+    void stop();
+    int getNumWorkers() const { return (int)mWorkers.size(); }
+
+    //calls function(item) for every item in [0, numItems) and returns when all are done
+    //no allocation, safe on the audio thread
+    template <typename Function>
+    void run(int numItems, Function& function) {
+        runItems(numItems, [](void* context, int item) { (*static_cast<Function*>(context))(item); }, &function);
+    }
+
+private:
+    using ItemFunction = void (*)(void*, int);
+
+    void runItems(int numItems, ItemFunction function, void* context);
+    struct Worker;
+    void workerLoop(Worker& worker);
+    //claims and runs items of 'generation' until none are left or the run moved on
+    void takeItems(std::uint32_t generation);
+
+    //generation (32 bits) | item count (16 bits) | next item (16 bits)
+    //a thread holding an old generation can never claim an item of a newer run
+    static std::uint64_t pack(std::uint32_t generation, int numItems, int nextItem);
+    std::atomic<std::uint64_t> mWork{ 0 };
+    std::atomic<int> mItemsDone{ 0 };
+    //only read after an item has been claimed, so they belong to the claimed run
+    ItemFunction mFunction = nullptr;
+    void* mContext = nullptr;
+
+    //parking
+    //spin first so back to back runs in one block don't pay for a wake up
+    static constexpr int spinIterations = 2000;
+    struct Worker {
+        std::thread thread;
+        std::atomic<bool> parked{ false };
+    };
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::mutex mParkMutex;
+    std::condition_variable mParkCondition;
+    std::atomic<bool> mExit{ false };
+};
@@ -13,6 +13,8 @@
 #include "DistortionProcessor.h"
 #include <cmath>
 #include <algorithm>
+#include <limits>
+#include <type_traits>
 
 void DistortionProcessor::setDistortionType(DistortionTypes newType) {
     type = newType;
@@ -20,24 +22,110 @@ void DistortionProcessor::setDistortionType(DistortionTypes newType) {
 }
 
 void DistortionProcessor::reset() {
-    //empty but maybe used later for state types
+    //dc blocker used by the asymmetric and rectify types
+    dcEstimates.fill(0.0f);
+}
+
+void DistortionProcessor::syncToFirstChannel() {
+    dcEstimates.fill(dcEstimates[0]);
+}
+
+template <DistortionTypes curve>
+float DistortionProcessor::shape(float input, float& dcEstimate) {
+    if constexpr (curve == DistortionTypes::HardClip) return hardClip(input);
+    else if constexpr (curve == DistortionTypes::SoftClip) return softClip(input);
+    else if constexpr (curve == DistortionTypes::ExpDistortion) return expDistortion(input);
+    else if constexpr (curve == DistortionTypes::CubicClip) return cubicSoftClip(input);
+    else if constexpr (curve == DistortionTypes::Arctangent) return arctangentClip(input);
+    else if constexpr (curve == DistortionTypes::Asymmetric) return asymmetricClip(input, dcEstimate);
+    else if constexpr (curve == DistortionTypes::FullRectify) return fullRectify(input, dcEstimate);
+    else if constexpr (curve == DistortionTypes::HalfRectify) return halfRectify(input, dcEstimate);
+    else return input;
+}
+
+template <DistortionTypes curve>
+void DistortionProcessor::processRun(float* samples, int numFrames, int numChannels, int firstChannel) {
+    //mono and stereo get their own loops so the channel loop unrolls
+    auto run = [&](auto channels) {
+        constexpr int fixedChannels = decltype(channels)::value;
+        const int frameSize = fixedChannels > 0 ? fixedChannels : numChannels;
+        for (int frame = 0; frame < numFrames; frame++) {
+            float* frameSamples = samples + frame * frameSize;
+            for (int channel = 0; channel < frameSize; channel++)
+                frameSamples[channel] = shape<curve>(frameSamples[channel], dcEstimates[firstChannel + channel]);
+        }
+    };
+
+    switch (numChannels) {
+    case 1: run(std::integral_constant<int, 1>()); break;
+    case 2: run(std::integral_constant<int, 2>()); break;
+    default: run(std::integral_constant<int, 0>()); break;
+    }
 }
 
 float DistortionProcessor::processSample(float input) {
+    float& dcEstimate = dcEstimates[0];
     switch (type) {
-    case DistortionTypes::None: return input;
-    case DistortionTypes::HardClip: return hardClip(input);
-    case DistortionTypes::SoftClip: return softClip(input);
-    case DistortionTypes::ExpDistortion: return expDistortion(input);
-    case DistortionTypes::CubicClip: return cubicSoftClip(input);
-    case DistortionTypes::Arctangent: return arctangentClip(input);
-    case DistortionTypes::Asymmetric: return asymmetricClip(input);
-    case DistortionTypes::FullRectify: return fullRectify(input);
-    case DistortionTypes::HalfRectify: return halfRectify(input);
+    case DistortionTypes::HardClip: return shape<DistortionTypes::HardClip>(input, dcEstimate);
+    case DistortionTypes::SoftClip: return shape<DistortionTypes::SoftClip>(input, dcEstimate);
+    case DistortionTypes::ExpDistortion: return shape<DistortionTypes::ExpDistortion>(input, dcEstimate);
+    case DistortionTypes::CubicClip: return shape<DistortionTypes::CubicClip>(input, dcEstimate);
+    case DistortionTypes::Arctangent: return shape<DistortionTypes::Arctangent>(input, dcEstimate);
+    case DistortionTypes::Asymmetric: return shape<DistortionTypes::Asymmetric>(input, dcEstimate);
+    case DistortionTypes::FullRectify: return shape<DistortionTypes::FullRectify>(input, dcEstimate);
+    case DistortionTypes::HalfRectify: return shape<DistortionTypes::HalfRectify>(input, dcEstimate);
     default: return input;
     }
 }
 
+//dispatch once per run, each case is its own branch free loop
+void DistortionProcessor::processBlock(float* samples, int numFrames, int numChannels, int firstChannel) {
+    numChannels = std::clamp(numChannels, 0, maxChannels - firstChannel);
+    switch (type) {
+    case DistortionTypes::HardClip: processRun<DistortionTypes::HardClip>(samples, numFrames, numChannels, firstChannel); break;
+    case DistortionTypes::SoftClip: processRun<DistortionTypes::SoftClip>(samples, numFrames, numChannels, firstChannel); break;
+    case DistortionTypes::ExpDistortion: processRun<DistortionTypes::ExpDistortion>(samples, numFrames, numChannels, firstChannel); break;
+    case DistortionTypes::CubicClip: processRun<DistortionTypes::CubicClip>(samples, numFrames, numChannels, firstChannel); break;
+    case DistortionTypes::Arctangent: processRun<DistortionTypes::Arctangent>(samples, numFrames, numChannels, firstChannel); break;
+    case DistortionTypes::Asymmetric: processRun<DistortionTypes::Asymmetric>(samples, numFrames, numChannels, firstChannel); break;
+    case DistortionTypes::FullRectify: processRun<DistortionTypes::FullRectify>(samples, numFrames, numChannels, firstChannel); break;
+    case DistortionTypes::HalfRectify: processRun<DistortionTypes::HalfRectify>(samples, numFrames, numChannels, firstChannel); break;
+    default: break;
+    }
+}
+
+//knees for adaptive oversampling
+//small signal error of each curve against its linear slope
+float DistortionProcessor::getLinearLimit(DistortionTypes type) {
+    switch (type) {
+    case DistortionTypes::None: return std::numeric_limits<float>::max();
+    case DistortionTypes::HardClip: return 1.0f;         //linear right up to the threshold
+    case DistortionTypes::SoftClip: return 0.001f;       //error ~ |x|
+    case DistortionTypes::ExpDistortion: return 0.0004f; //error ~ 2.5|x|
+    case DistortionTypes::CubicClip: return 0.055f;      //error ~ x^2 / 3
+    case DistortionTypes::Arctangent: return 0.011f;     //error ~ (5x)^2 / 3
+    default: return 0.0f;                                //asymmetric and rectifiers are never linear
+    }
+}
+
+int DistortionProcessor::getHarmonicReach(DistortionTypes type, float peak) {
+    float limit = getLinearLimit(type);
+    if (peak <= limit)
+        return 1;
+
+    //hard edges spray harmonics a long way
+    bool hardEdge = type == DistortionTypes::HardClip
+        || type == DistortionTypes::FullRectify
+        || type == DistortionTypes::HalfRectify
+        || (type == DistortionTypes::CubicClip && peak > 1.0f);
+    if (hardEdge || limit <= 0.0f)
+        return 15;
+
+    //smooth curves gain roughly two more odd harmonics every 12dB past the knee
+    int order = 1 + 2 * (int)std::ceil(std::log2(peak / limit) / 2.0f);
+    return std::min(order, 15);
+}
+
 //DAFx distortion algorithms
 float DistortionProcessor::hardClip(float input) {
     const float threshold = 1.0f;
@@ -62,24 +150,24 @@ float DistortionProcessor::arctangentClip(float input) {
     return std::atan(G * input) / std::atan(G);
 }
 
-float DistortionProcessor::asymmetricClip(float input) {
+float DistortionProcessor::asymmetricClip(float input, float& dcEstimate) {
     const float G = 5.0f;
     const float H = 2.0f;
     if (input >= 0.0f)
-        return removeDC(std::atan(G * input) / std::atan(G));
+        return removeDC(std::atan(G * input) / std::atan(G), dcEstimate);
     else
-        return removeDC(std::atan(G * H * input) / std::atan(G * H));
+        return removeDC(std::atan(G * H * input) / std::atan(G * H), dcEstimate);
 }
 
-float DistortionProcessor::fullRectify(float input) {
-    return removeDC(std::abs(input));
+float DistortionProcessor::fullRectify(float input, float& dcEstimate) {
+    return removeDC(std::abs(input), dcEstimate);
 }
 
-float DistortionProcessor::halfRectify(float input) {
-    return removeDC(std::max(0.0f, input));
+float DistortionProcessor::halfRectify(float input, float& dcEstimate) {
+    return removeDC(std::max(0.0f, input), dcEstimate);
 }
 
-float DistortionProcessor::removeDC(float input){
+float DistortionProcessor::removeDC(float input, float& dcEstimate) {
     dcEstimate = dcAlpha * dcEstimate + (1.0f - dcAlpha) * input;
     return input - dcEstimate;
 }
\ No newline at end of file
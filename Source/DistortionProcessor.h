@@ -10,17 +10,30 @@
 
 #pragma once
 #include "DistortionTypes.h"
+#include <array>
 
 class DistortionProcessor {
 public:
     DistortionProcessor() = default;
     void setDistortionType(DistortionTypes newType);
     DistortionTypes getType() const { return type; };
+    //one channel, on the first channel's dc blocker
     float processSample(float input);
+    //shapes numFrames interleaved frames of numChannels in place, the curve is picked once for the whole run
+    //each channel has its own dc blocker, the frames are channels firstChannel and up (planar data is 1 channel)
+    static constexpr int maxChannels = 12; //7.1.4
+    void processBlock(float* samples, int numFrames, int numChannels, int firstChannel = 0);
     void reset();
+    //copies the first channel's dc blocker into every other channel
+    void syncToFirstChannel();
+
+    //input level below which the curve is effectively linear (products under -60dB)
+    static float getLinearLimit(DistortionTypes type);
+    //rough highest harmonic that still matters when the curve is driven to 'peak'
+    static int getHarmonicReach(DistortionTypes type, float peak);
 private:
-    //dc removal
-    float dcEstimate = 0.0f;
+    //dc removal, per channel so one channel's offset never leaks into another
+    std::array<float, maxChannels> dcEstimates{};
     float dcAlpha = 0.999f;
 
     //initaliser
@@ -31,10 +44,16 @@ private:
     float expDistortion(float input);
     float cubicSoftClip(float input);
     float arctangentClip(float input);
-    float asymmetricClip(float input);
-    float fullRectify(float input);
-    float halfRectify(float input);
-    float removeDC(float input);
+    float asymmetricClip(float input, float& dcEstimate);
+    float fullRectify(float input, float& dcEstimate);
+    float halfRectify(float input, float& dcEstimate);
+    float removeDC(float input, float& dcEstimate);
+
+    //one kernel per curve, the type is a template argument so the loop has no branch on it
+    template <DistortionTypes curve>
+    float shape(float input, float& dcEstimate);
+    template <DistortionTypes curve>
+    void processRun(float* samples, int numFrames, int numChannels, int firstChannel);
 
     //states for other types of dist
 };
\ No newline at end of file
@@ -10,6 +10,7 @@
 
 
 #include "FilterClasses.h"
+#include <algorithm>
 
 //=================filter base=================
 void Filter::setSampleRate(double sampleRate) {
@@ -62,60 +63,340 @@ void ButterworthHighPass::updateCoefs() {
     a2 = b0 * (1.0 - sqrt(2.0) * c + c2);
 }
 
-//=================Linkwitz-Riley LowPass=================
-void LinkwitzRileyLowPass::setSampleRate(double sampleRate) {
-    mSampleRate = sampleRate;
-    filter1.setSampleRate(sampleRate);
-    filter2.setSampleRate(sampleRate);
+//=================multichannel helpers=================
+namespace {
+    //polynomials in z^-1, lowest power first
+    using Polynomial = std::vector<double>;
+
+    Polynomial multiply(const Polynomial& a, const Polynomial& b) {
+        Polynomial result(a.size() + b.size() - 1, 0.0);
+        for (size_t i = 0; i < a.size(); i++)
+            for (size_t j = 0; j < b.size(); j++)
+                result[i + j] += a[i] * b[j];
+        return result;
+    }
+
+    Polynomial multiply(std::initializer_list<Polynomial> factors) {
+        Polynomial result = { 1.0 };
+        for (auto& factor : factors)
+            result = multiply(result, factor);
+        return result;
+    }
+
+    template <typename T>
+    T evaluate(const Polynomial& p, T x) {
+        T result = 0.0;
+        for (size_t i = p.size(); i-- > 0;)
+            result = result * x + p[i];
+        return result;
+    }
+
+    //Durand-Kerner, then a couple of Newton steps against the original polynomial
+    std::vector<std::complex<double>> findRoots(const Polynomial& p) {
+        const int degree = (int)p.size() - 1;
+        std::vector<std::complex<double>> roots(degree);
+
+        //start spread on a circle that holds every root (Cauchy bound)
+        double bound = 0.0;
+        for (int i = 0; i < degree; i++)
+            bound = std::max(bound, std::abs(p[i] / p[degree]));
+        bound += 1.0;
+        const std::complex<double> seed(0.4, 0.9);
+        for (int i = 0; i < degree; i++)
+            roots[i] = bound * std::pow(seed / std::abs(seed), i) * 0.5;
+
+        for (int iteration = 0; iteration < 1000; iteration++) {
+            double largestStep = 0.0;
+            for (int i = 0; i < degree; i++) {
+                std::complex<double> denominator = p[degree];
+                for (int j = 0; j < degree; j++)
+                    if (j != i)
+                        denominator *= roots[i] - roots[j];
+                auto step = evaluate(p, roots[i]) / denominator;
+                roots[i] -= step;
+                largestStep = std::max(largestStep, std::abs(step) / std::max(1.0, std::abs(roots[i])));
+            }
+            if (largestStep < 1.0e-15)
+                break;
+        }
+
+        Polynomial derivative(degree);
+        for (int i = 1; i <= degree; i++)
+            derivative[i - 1] = p[i] * i;
+        for (auto& root : roots) {
+            for (int iteration = 0; iteration < 3; iteration++) {
+                auto slope = evaluate(derivative, root);
+                if (std::abs(slope) > 0.0)
+                    root -= evaluate(p, root) / slope;
+            }
+        }
+        return roots;
+    }
+
+    Polynomial numerator(const BiQuad::Coefs& c) { return { c.b0, c.b1, c.b2 }; }
+    Polynomial denominator(const BiQuad::Coefs& c) { return { 1.0, c.a1, c.a2 }; }
+
+    //direct form 1 cascade, every section has its own coefficients
+    //one lane per channel, the same diff eq as BiQuad
+    void processCascade(const BiQuad::Coefs* coefs, int numSections,
+        std::vector<double>* x1s, std::vector<double>* x2s, std::vector<double>* y1s, std::vector<double>* y2s,
+        int numChannels, const double* input, double* output, int numFrames) {
+        for (int frame = 0; frame < numFrames; frame++) {
+            const double* in = input + frame * numChannels;
+            double* out = output + frame * numChannels;
+
+            for (int section = 0; section < numSections; section++) {
+                const double b0 = coefs[section].b0, b1 = coefs[section].b1, b2 = coefs[section].b2;
+                const double a1 = coefs[section].a1, a2 = coefs[section].a2;
+                double* x1 = x1s[section].data();
+                double* x2 = x2s[section].data();
+                double* y1 = y1s[section].data();
+                double* y2 = y2s[section].data();
+
+                for (int channel = 0; channel < numChannels; channel++) {
+                    double x = in[channel];
+                    double y = b0 * x + b1 * x1[channel] + b2 * x2[channel] - a1 * y1[channel] - a2 * y2[channel];
+                    x2[channel] = x1[channel];
+                    x1[channel] = x;
+                    y2[channel] = y1[channel];
+                    y1[channel] = y;
+                    out[channel] = y;
+                }
+
+                //next section runs on this one's output
+                in = out;
+            }
+        }
+    }
+
+    void syncCascade(int numSections, std::vector<double>* x1s, std::vector<double>* x2s,
+        std::vector<double>* y1s, std::vector<double>* y2s) {
+        for (int section = 0; section < numSections; section++) {
+            for (auto* state : { &x1s[section], &x2s[section], &y1s[section], &y2s[section] }) {
+                if (!state->empty())
+                    std::fill(state->begin() + 1, state->end(), state->front());
+            }
+        }
+    }
+}
+
+//=================Linkwitz-Riley Bank=================
+void LinkwitzRileyBank::prepare(Type type, int numChannels) {
+    mType = type;
+    mNumChannels = numChannels;
+    for (int section = 0; section < 2; section++) {
+        mX1[section].assign(numChannels, 0.0);
+        mX2[section].assign(numChannels, 0.0);
+        mY1[section].assign(numChannels, 0.0);
+        mY2[section].assign(numChannels, 0.0);
+    }
     updateCoefs();
 }
 
-void LinkwitzRileyLowPass::setCutoff(double cutoff) {
-    mCutoff = cutoff;
-    filter1.setCutoff(cutoff);
-    filter2.setCutoff(cutoff);
+void LinkwitzRileyBank::setSampleRate(double sampleRate) {
+    mLowPassDesign.setSampleRate(sampleRate);
+    mHighPassDesign.setSampleRate(sampleRate);
     updateCoefs();
 }
 
-double LinkwitzRileyLowPass::process(double input) {
-    return filter2.process(filter1.process(input));
+void LinkwitzRileyBank::setCutoff(double cutoff) {
+    mLowPassDesign.setCutoff(cutoff);
+    mHighPassDesign.setCutoff(cutoff);
+    updateCoefs();
 }
 
-void LinkwitzRileyLowPass::updateCoefs() {
-    filter1.updateCoefs();
-    filter2.updateCoefs();
+void LinkwitzRileyBank::updateCoefs() {
+    if (mType == Type::LowPass) {
+        mLowPassDesign.updateCoefs();
+        mCoefs = mLowPassDesign.getCoefs();
+    }
+    else {
+        mHighPassDesign.updateCoefs();
+        mCoefs = mHighPassDesign.getCoefs();
+    }
 }
 
-void LinkwitzRileyLowPass::reset() {
-    filter1.reset();
-    filter2.reset();
+void LinkwitzRileyBank::reset() {
+    for (int section = 0; section < 2; section++) {
+        std::fill(mX1[section].begin(), mX1[section].end(), 0.0);
+        std::fill(mX2[section].begin(), mX2[section].end(), 0.0);
+        std::fill(mY1[section].begin(), mY1[section].end(), 0.0);
+        std::fill(mY2[section].begin(), mY2[section].end(), 0.0);
+    }
 }
 
-//=================Linkwitz-Riley HighPass=================
-void LinkwitzRileyHighPass::setSampleRate(double sampleRate) {
-    mSampleRate = sampleRate;
-    filter1.setSampleRate(sampleRate);
-    filter2.setSampleRate(sampleRate);
-    updateCoefs();
+void LinkwitzRileyBank::process(const double* input, double* output, int numFrames, int numChannels) {
+    const BiQuad::Coefs coefs[2] = { mCoefs, mCoefs };
+    processCascade(coefs, 2, mX1, mX2, mY1, mY2, std::min(numChannels, mNumChannels), input, output, numFrames);
 }
 
-void LinkwitzRileyHighPass::setCutoff(double cutoff) {
-    mCutoff = cutoff;
-    filter1.setCutoff(cutoff);
-    filter2.setCutoff(cutoff);
-    updateCoefs();
+void LinkwitzRileyBank::syncToFirstChannel() {
+    syncCascade(2, mX1, mX2, mY1, mY2);
+}
+
+//=================Collapsed Crossover=================
+void CollapsedCrossover::prepare(int numChannels) {
+    mNumChannels = numChannels;
+    for (int section = 0; section < numSections; section++) {
+        mX1[section].assign(numChannels, 0.0);
+        mX2[section].assign(numChannels, 0.0);
+        mY1[section].assign(numChannels, 0.0);
+        mY2[section].assign(numChannels, 0.0);
+    }
+}
+
+CollapsedCrossover::Design CollapsedCrossover::design(double sampleRate, double freq1, double freq2, double freq3) {
+    Design result;
+    result.sampleRate = sampleRate;
+    result.freqs[0] = freq1;
+    result.freqs[1] = freq2;
+    result.freqs[2] = freq3;
+    auto& coefs = result.coefs;
+
+    //same butterworth designs the split uses
+    const double freqs[3] = { freq1, freq2, freq3 };
+    BiQuad::Coefs lowPass[3], highPass[3];
+    for (int i = 0; i < 3; i++) {
+        ButterworthLowPass lowDesign;
+        lowDesign.setSampleRate(sampleRate);
+        lowDesign.setCutoff(freqs[i]);
+        lowDesign.updateCoefs();
+        lowPass[i] = lowDesign.getCoefs();
+
+        ButterworthHighPass highDesign;
+        highDesign.setSampleRate(sampleRate);
+        highDesign.setCutoff(freqs[i]);
+        highDesign.updateCoefs();
+        highPass[i] = highDesign.getCoefs();
+    }
+
+    //the designs are bilinear transforms of analog butterworths at the prewarped cutoffs
+    //so the zeros of the sum are found in the analog domain, where they are well spread out
+    //(in z^-1 they all crowd around 1 and double precision can't separate them)
+    //low and high pass of one crossover share B = s^2 + sqrt2 w s + w^2, so the sum is
+    //  (w1^4 B2^2 B3^2 + s^4 w2^4 B3^2 + s^4 w3^4 B1^2 + s^4 B1^2 B2^2) / (B1^2 B2^2 B3^2)
+    //s is scaled by the middle cutoff to keep the coefficients near 1
+    double w[3];
+    for (int i = 0; i < 3; i++)
+        w[i] = std::tan(M_PI * freqs[i] / sampleRate);
+    const double scale = w[1];
+
+    Polynomial b[3], w4[3];
+    for (int i = 0; i < 3; i++) {
+        double wi = w[i] / scale;
+        b[i] = { wi * wi, std::sqrt(2.0) * wi, 1.0 };
+        w4[i] = { wi * wi * wi * wi };
+    }
+    const Polynomial s4 = { 0.0, 0.0, 0.0, 0.0, 1.0 };
+    Polynomial terms[4] = {
+        multiply({ w4[0], b[1], b[1], b[2], b[2] }),
+        multiply({ s4, w4[1], b[2], b[2] }),
+        multiply({ s4, w4[2], b[0], b[0] }),
+        multiply({ s4, b[0], b[0], b[1], b[1] })
+    };
+    Polynomial sum(13, 0.0);
+    for (auto& term : terms)
+        for (size_t i = 0; i < term.size(); i++)
+            sum[i] += term[i];
+
+    //zeros of the sum, mapped back to z^-1 and paired up into real biquad numerators
+    std::vector<std::pair<std::complex<double>, std::complex<double>>> zeroPairs;
+    std::vector<double> realRoots;
+    std::vector<std::complex<double>> complexRoots;
+    auto roots = findRoots(sum);
+    for (auto& root : roots) {
+        root *= scale;
+        if (std::abs(root.imag()) <= 1.0e-9 * std::abs(root))
+            realRoots.push_back(root.real());
+        else if (root.imag() > 0.0)
+            complexRoots.push_back(root);
+    }
+    if (realRoots.size() % 2 != 0 || realRoots.size() + complexRoots.size() * 2 != roots.size())
+        return result;
+
+    //z^-1 = (1 - s) / (1 + s)
+    auto toDigital = [](std::complex<double> analog) { return (1.0 - analog) / (1.0 + analog); };
+    for (auto& root : complexRoots)
+        zeroPairs.push_back({ toDigital(root), toDigital(std::conj(root)) });
+    std::sort(realRoots.begin(), realRoots.end());
+    for (size_t i = 0; i < realRoots.size(); i += 2)
+        zeroPairs.push_back({ toDigital(realRoots[i]), toDigital(realRoots[i + 1]) });
+
+    //each zero pair goes with the crossover poles nearest to it
+    Polynomial d[3];
+    for (int i = 0; i < 3; i++)
+        d[i] = denominator(lowPass[i]);
+    bool used[numSections] = {};
+    for (int section = 0; section < numSections; section++) {
+        const auto& poles = d[section / 2];
+        auto pole = (-poles[1] + std::sqrt(std::complex<double>(poles[1] * poles[1] - 4.0 * poles[2]))) / (2.0 * poles[2]);
+
+        int nearest = -1;
+        for (int pair = 0; pair < numSections; pair++) {
+            if (!used[pair] && (nearest < 0 || std::abs(zeroPairs[pair].first - pole) < std::abs(zeroPairs[nearest].first - pole)))
+                nearest = pair;
+        }
+        used[nearest] = true;
+
+        //(1 - z^-1 / r1)(1 - z^-1 / r2)
+        auto r1 = zeroPairs[nearest].first;
+        auto r2 = zeroPairs[nearest].second;
+        coefs[section] = { 1.0, -(1.0 / r1 + 1.0 / r2).real(), (1.0 / (r1 * r2)).real(), poles[1], poles[2] };
+    }
+
+    //the split as it runs, to set the gain and check the result against
+    auto split = [&](std::complex<double> q) {
+        std::complex<double> lp[3], hp[3];
+        for (int i = 0; i < 3; i++) {
+            auto lowPassSection = evaluate(numerator(lowPass[i]), q) / evaluate(denominator(lowPass[i]), q);
+            auto highPassSection = evaluate(numerator(highPass[i]), q) / evaluate(denominator(highPass[i]), q);
+            lp[i] = lowPassSection * lowPassSection;
+            hp[i] = highPassSection * highPassSection;
+        }
+        return lp[0] + hp[0] * lp[1] + hp[1] * lp[2] + hp[2];
+    };
+    auto cascade = [&coefs](std::complex<double> q) {
+        std::complex<double> response = 1.0;
+        for (auto& section : coefs)
+            response *= evaluate(numerator(section), q) / evaluate(denominator(section), q);
+        return response;
+    };
+
+    //gain matched at nyquist, where only the high band passes
+    double gain = (split(-1.0) / cascade(-1.0)).real();
+    coefs[0].b0 *= gain;
+    coefs[0].b1 *= gain;
+    coefs[0].b2 *= gain;
+
+    //only worth using if it really is the same filter
+    for (int point = 0; point < 64; point++) {
+        //10Hz up to just under nyquist, log spaced
+        double freq = 10.0 * std::pow(sampleRate * 0.49 / 10.0, point / 63.0);
+        auto q = std::polar(1.0, -2.0 * M_PI * freq / sampleRate);
+        if (!(std::abs(cascade(q) - split(q)) < 1.0e-6))
+            return result;
+    }
+    result.valid = true;
+    return result;
 }
 
-double LinkwitzRileyHighPass::process(double input) {
-    return filter2.process(filter1.process(input));
+void CollapsedCrossover::setDesign(const Design& design) {
+    std::copy(std::begin(design.coefs), std::end(design.coefs), std::begin(mCoefs));
 }
 
-void LinkwitzRileyHighPass::updateCoefs() {
-    filter1.updateCoefs();
-    filter2.updateCoefs();
+void CollapsedCrossover::reset() {
+    for (int section = 0; section < numSections; section++) {
+        std::fill(mX1[section].begin(), mX1[section].end(), 0.0);
+        std::fill(mX2[section].begin(), mX2[section].end(), 0.0);
+        std::fill(mY1[section].begin(), mY1[section].end(), 0.0);
+        std::fill(mY2[section].begin(), mY2[section].end(), 0.0);
+    }
 }
 
-void LinkwitzRileyHighPass::reset() {
-    filter1.reset();
-    filter2.reset();
-}
\ No newline at end of file
+void CollapsedCrossover::process(const double* input, double* output, int numFrames, int numChannels) {
+    processCascade(mCoefs, numSections, mX1, mX2, mY1, mY2, std::min(numChannels, mNumChannels), input, output, numFrames);
+}
+
+void CollapsedCrossover::syncToFirstChannel() {
+    syncCascade(numSections, mX1, mX2, mY1, mY2);
+}
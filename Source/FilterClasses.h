@@ -11,6 +11,8 @@
 #pragma once
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <complex>
+#include <vector>
 
 //filter base interface
 class Filter {
@@ -32,6 +34,10 @@ public:
     double process(double input) override;
     void reset() override;
 
+    //a0 is always 1
+    struct Coefs { double b0, b1, b2, a1, a2; };
+    Coefs getCoefs() const { return { b0, b1, b2, a1, a2 }; }
+
 protected:
     //coefficients
     double b0, b1, b2;
@@ -52,27 +58,68 @@ public:
     void updateCoefs() override;
 };
 
-//Linkwitz-Riley Filters
-class LinkwitzRileyLowPass : public Filter {
+//Linkwitz-Riley filter for every channel of a bus at once
+//all channels share the coefficients, states are stored [channel] per section
+//so the channel loop of each frame runs side by side in SIMD lanes
+class LinkwitzRileyBank {
 public:
-    void setSampleRate(double sampleRate) override;
-    void setCutoff(double cutoff) override;
-    double process(double input) override;
-    void updateCoefs() override;
-    void reset() override;
+    enum class Type { LowPass, HighPass };
+
+    void prepare(Type type, int numChannels);
+    void setSampleRate(double sampleRate);
+    void setCutoff(double cutoff);
+    void reset();
+
+    //interleaved frames of numChannels (the first lanes of what was prepared), input and output may be the same
+    void process(const double* input, double* output, int numFrames, int numChannels);
+    //copies the first channel's state into every other channel
+    void syncToFirstChannel();
 
 private:
-    ButterworthLowPass filter1, filter2;
+    void updateCoefs();
+
+    Type mType = Type::LowPass;
+    int mNumChannels = 0;
+    //coefficients come from the single channel designs so both paths match
+    ButterworthLowPass mLowPassDesign;
+    ButterworthHighPass mHighPassDesign;
+    BiQuad::Coefs mCoefs = {};
+
+    //two cascaded butterworth sections
+    std::vector<double> mX1[2], mX2[2], mY1[2], mY2[2];
 };
 
-class LinkwitzRileyHighPass : public Filter {
+//the whole 4 band split summed back together, as one filter
+//only valid while every band is linear and gets the same gain
+//the numerator of the sum is factored into biquads that share the crossover poles
+//6 sections per channel instead of the 12 the split runs
+class CollapsedCrossover {
 public:
-    void setSampleRate(double sampleRate) override;
-    void setCutoff(double cutoff) override;
-    double process(double input) override;
-    void updateCoefs() override;
-    void reset() override;
+    static constexpr int numSections = 6;
+
+    //the cascade for one set of crossovers, worked out away from the audio thread
+    struct Design {
+        double sampleRate = 0.0;
+        double freqs[3] = {};
+        //false when the factored cascade doesn't match the split closely enough, then it must not be used
+        bool valid = false;
+        BiQuad::Coefs coefs[numSections] = {};
+    };
+
+    void prepare(int numChannels);
+    //allocates and iterates, not realtime safe
+    static Design design(double sampleRate, double freq1, double freq2, double freq3);
+    //only copies the coefficients, states are kept
+    void setDesign(const Design& design);
+    void reset();
+
+    //interleaved frames of numChannels (the first lanes of what was prepared), input and output may be the same
+    void process(const double* input, double* output, int numFrames, int numChannels);
+    //copies the first channel's state into every other channel
+    void syncToFirstChannel();
 
 private:
-    ButterworthHighPass filter1, filter2;
-};
\ No newline at end of file
+    int mNumChannels = 0;
+    BiQuad::Coefs mCoefs[numSections] = {};
+    std::vector<double> mX1[numSections], mX2[numSections], mY1[numSections], mY2[numSections];
+};
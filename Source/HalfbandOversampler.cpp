@@ -0,0 +1,332 @@
+/*
+  ==============================================================================
+
+    HalfbandOversampler.cpp
+    Created: 19 Oct 2026 2:41:19pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#define _USE_MATH_DEFINES
+
+#include "HalfbandOversampler.h"
+#include <cmath>
+#include <algorithm>
+
+//=================coefficient design=================
+//elliptic halfband via the polyphase allpass method (Valenzuela & Constantinides)
+//same approach as de Soras' hiir designer
+namespace {
+    double computeAccNum(double q, int order, int c) {
+        double acc = 0.0;
+        double term = 0.0;
+        int i = 0;
+        int sign = 1;
+        do {
+            term = std::pow(q, i * (i + 1)) * std::sin((i * 2 + 1) * c * M_PI / order) * sign;
+            acc += term;
+            sign = -sign;
+            i++;
+        } while (std::abs(term) > 1e-100);
+        return acc;
+    }
+
+    double computeAccDen(double q, int order, int c) {
+        double acc = 0.0;
+        double term = 0.0;
+        int i = 1;
+        int sign = -1;
+        do {
+            term = std::pow(q, i * i) * std::cos(i * 2 * c * M_PI / order) * sign;
+            acc += term;
+            sign = -sign;
+            i++;
+        } while (std::abs(term) > 1e-100);
+        return acc;
+    }
+}
+
+void HalfbandStage::design(double attenuationDb, double transition) {
+    //transition parameters
+    double k = std::tan((1.0 - transition * 2.0) * M_PI / 4.0);
+    k *= k;
+    double kksqrt = std::pow(1.0 - k * k, 0.25);
+    double e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+    double e2 = e * e;
+    double e4 = e2 * e2;
+    double q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+    //order needed for the attenuation, always odd
+    double attn = std::pow(10.0, -attenuationDb / 10.0);
+    double a = attn / (1.0 - attn);
+    int order = (int)std::ceil(std::log(a * a / 16.0) / std::log(q));
+    if (order % 2 == 0)
+        order++;
+    order = std::max(order, 3);
+    //both paths get the same number of sections, the registers run them side by side anyway
+    if ((order - 1) / 2 % 2 != 0)
+        order += 2;
+    int numCoefs = (order - 1) / 2;
+
+    mCoefs.resize(numCoefs);
+    for (int index = 0; index < numCoefs; index++) {
+        int c = index + 1;
+        double num = computeAccNum(q, order, c) * std::pow(q, 0.25);
+        double den = computeAccDen(q, order, c) + 0.5;
+        double ww = num / den;
+        double wwsq = ww * ww;
+        double x = std::sqrt((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+        mCoefs[index] = (float)((1.0 - x) / (1.0 + x));
+    }
+}
+
+namespace {
+    //the float lanes behind a run of registers
+    float* getLanes(std::vector<HalfbandStage::Vec>& registers) { return reinterpret_cast<float*>(registers.data()); }
+}
+
+void HalfbandStage::prepare(int numChannels) {
+    mNumChannels = numChannels;
+    mNumVecs = getNumVecs(numChannels);
+    fillCoefs(mUpCoefs, true);
+    fillCoefs(mDownCoefs, false);
+
+    size_t stateSize = mCoefs.size() / 2 * mNumVecs;
+    mUpX.assign(stateSize, Vec::expand(0.0f));
+    mUpY.assign(stateSize, Vec::expand(0.0f));
+    mDownX.assign(stateSize, Vec::expand(0.0f));
+    mDownY.assign(stateSize, Vec::expand(0.0f));
+    mFrames.assign((size_t)chunkFrames * mNumVecs, Vec::expand(0.0f));
+}
+
+void HalfbandStage::fillCoefs(std::vector<Vec>& coefs, bool pathZeroFirst) const {
+    const int numPairs = (int)mCoefs.size() / 2;
+    const int numLanes = mNumVecs * (int)Vec::SIMDNumElements;
+    coefs.assign((size_t)numPairs * mNumVecs, Vec::expand(0.0f));
+
+    //padding lanes past both paths keep a zero coef and only ever see zeros
+    float* lanes = getLanes(coefs);
+    for (int pair = 0; pair < numPairs; pair++) {
+        for (int lane = 0; lane < mNumChannels * 2; lane++) {
+            int path = lane < mNumChannels ? (pathZeroFirst ? 0 : 1) : (pathZeroFirst ? 1 : 0);
+            lanes[pair * numLanes + lane] = mCoefs[pair * 2 + path];
+        }
+    }
+}
+
+void HalfbandStage::reset() {
+    for (auto* state : { &mUpX, &mUpY, &mDownX, &mDownY })
+        std::fill(state->begin(), state->end(), Vec::expand(0.0f));
+}
+
+void HalfbandStage::syncToFirstChannel() {
+    const int numLanes = mNumVecs * (int)Vec::SIMDNumElements;
+    for (auto* state : { &mUpX, &mUpY, &mDownX, &mDownY }) {
+        for (size_t pair = 0; pair < mCoefs.size() / 2; pair++) {
+            for (int path = 0; path < 2; path++) {
+                float* lanes = getLanes(*state) + pair * numLanes + path * mNumChannels;
+                std::fill(lanes + 1, lanes + mNumChannels, lanes[0]);
+            }
+        }
+    }
+}
+
+//first order allpass sections in the low rate, every register holds both paths, a pair of coefs per step
+//y = a * (x - y1) + x1
+template <int NumChannels>
+void HalfbandStage::processFrames(const Vec* coefs, Vec* x, Vec* y, int numFrames, int numChannels) {
+    const int numVecs = NumChannels > 0 ? getNumVecs(NumChannels) : mNumVecs;
+    const size_t numPairs = mCoefs.size() / 2;
+
+    for (int frame = 0; frame < numFrames; frame++) {
+        for (int index = 0; index < numVecs; index++) {
+            Vec samples = mFrames[frame * numVecs + index];
+            for (size_t pair = 0; pair < numPairs; pair++) {
+                const size_t state = pair * numVecs + index;
+                Vec out = coefs[state] * (samples - y[state]) + x[state];
+                x[state] = samples;
+                y[state] = out;
+                samples = out;
+            }
+            mFrames[frame * numVecs + index] = samples;
+        }
+    }
+}
+
+template <int NumChannels>
+void HalfbandStage::upsampleFrames(const float* input, float* output, int numFrames, int numChannels) {
+    const int channels = NumChannels > 0 ? NumChannels : numChannels;
+    const int numLanes = (NumChannels > 0 ? getNumVecs(NumChannels) : mNumVecs) * (int)Vec::SIMDNumElements;
+    float* lanes = getLanes(mFrames);
+
+    //path 0 in the first half of a frame, path 1 in the second, which is also the output order
+    for (int start = 0; start < numFrames; start += chunkFrames) {
+        const int chunk = std::min(chunkFrames, numFrames - start);
+        const float* in = input + start * channels;
+        float* out = output + start * 2 * channels;
+
+        for (int frame = 0; frame < chunk; frame++) {
+            for (int channel = 0; channel < channels; channel++) {
+                lanes[frame * numLanes + channel] = in[frame * channels + channel];
+                lanes[frame * numLanes + channels + channel] = in[frame * channels + channel];
+            }
+        }
+
+        processFrames<NumChannels>(mUpCoefs.data(), mUpX.data(), mUpY.data(), chunk, channels);
+
+        for (int frame = 0; frame < chunk; frame++)
+            for (int lane = 0; lane < channels * 2; lane++)
+                out[frame * 2 * channels + lane] = lanes[frame * numLanes + lane];
+    }
+}
+
+template <int NumChannels>
+void HalfbandStage::downsampleFrames(const float* input, float* output, int numFrames, int numChannels) {
+    const int channels = NumChannels > 0 ? NumChannels : numChannels;
+    const int numLanes = (NumChannels > 0 ? getNumVecs(NumChannels) : mNumVecs) * (int)Vec::SIMDNumElements;
+    float* lanes = getLanes(mFrames);
+
+    //a pair of frames goes in as it is, the first through path 1 and the second through path 0
+    for (int start = 0; start < numFrames; start += chunkFrames) {
+        const int chunk = std::min(chunkFrames, numFrames - start);
+        const float* in = input + start * 2 * channels;
+        float* out = output + start * channels;
+
+        for (int frame = 0; frame < chunk; frame++)
+            for (int lane = 0; lane < channels * 2; lane++)
+                lanes[frame * numLanes + lane] = in[frame * 2 * channels + lane];
+
+        processFrames<NumChannels>(mDownCoefs.data(), mDownX.data(), mDownY.data(), chunk, channels);
+
+        for (int frame = 0; frame < chunk; frame++) {
+            const float* paths = lanes + frame * numLanes;
+            for (int channel = 0; channel < channels; channel++)
+                out[frame * channels + channel] = 0.5f * (paths[channel] + paths[channels + channel]);
+        }
+    }
+}
+
+void HalfbandStage::upsample(const float* input, float* output, int numFrames, int numChannels) {
+    switch (numChannels) {
+    case 1: upsampleFrames<1>(input, output, numFrames, numChannels); break;
+    case 2: upsampleFrames<2>(input, output, numFrames, numChannels); break;
+    default: upsampleFrames<0>(input, output, numFrames, numChannels); break;
+    }
+}
+
+void HalfbandStage::downsample(const float* input, float* output, int numFrames, int numChannels) {
+    switch (numChannels) {
+    case 1: downsampleFrames<1>(input, output, numFrames, numChannels); break;
+    case 2: downsampleFrames<2>(input, output, numFrames, numChannels); break;
+    default: downsampleFrames<0>(input, output, numFrames, numChannels); break;
+    }
+}
+
+//=================oversampler=================
+void HalfbandOversampler::prepare(int numStages, int numChannels, int maxBlockSize) {
+    mNumChannels = numChannels;
+    mStages.resize(numStages);
+
+    //first stage sits next to the host rate and keeps the audio band up to ~20k at 44.1k
+    //the later stages only have to protect what is left under host nyquist, so they can be much gentler
+    for (int stage = 0; stage < numStages; stage++) {
+        double transition = stage == 0 ? 0.04 : 0.5 - 0.5 / (1 << stage);
+        mStages[stage].design(90.0, std::min(transition, 0.4));
+        mStages[stage].prepare(numChannels);
+    }
+
+    mInterleaved.assign((size_t)maxBlockSize * numChannels, 0.0f);
+    for (auto& buffer : mBuffers)
+        buffer.assign((size_t)maxBlockSize * numChannels * getFactor(), 0.0f);
+
+    mLatency = measureLatency();
+}
+
+//centroid of the up/down impulse response, on a mono copy of the stages
+double HalfbandOversampler::measureLatency() const {
+    if (mStages.empty())
+        return 0.0;
+
+    const int length = 512;
+    HalfbandOversampler probe;
+    probe.mStages = mStages;
+    for (auto& stage : probe.mStages)
+        stage.prepare(1);
+    probe.mNumChannels = 1;
+    probe.mInterleaved.assign(length, 0.0f);
+    for (auto& buffer : probe.mBuffers)
+        buffer.assign((size_t)length * getFactor(), 0.0f);
+
+    std::vector<float> impulse(length, 0.0f);
+    impulse[0] = 1.0f;
+    float* channels[] = { impulse.data() };
+    probe.processSamplesUp(channels, 1, length);
+    probe.processSamplesDown(channels, 1, length);
+
+    double sum = 0.0;
+    double weighted = 0.0;
+    for (int i = 0; i < length; i++) {
+        sum += impulse[i];
+        weighted += i * impulse[i];
+    }
+    return sum != 0.0 ? weighted / sum : 0.0;
+}
+
+void HalfbandOversampler::reset() {
+    for (auto& stage : mStages)
+        stage.reset();
+}
+
+void HalfbandOversampler::syncToFirstChannel() {
+    for (auto& stage : mStages)
+        stage.syncToFirstChannel();
+}
+
+float* HalfbandOversampler::processSamplesUp(const float* const* channels, int numChannels, int numSamples) {
+    numChannels = std::min(numChannels, mNumChannels);
+
+    //interleave
+    float* interleaved = mInterleaved.data();
+    for (int channel = 0; channel < numChannels; channel++) {
+        const float* data = channels[channel];
+        for (int i = 0; i < numSamples; i++)
+            interleaved[i * numChannels + channel] = data[i];
+    }
+
+    const float* input = interleaved;
+    int numFrames = numSamples;
+    for (size_t stage = 0; stage < mStages.size(); stage++) {
+        float* output = mBuffers[stage % 2].data();
+        mStages[stage].upsample(input, output, numFrames, numChannels);
+        input = output;
+        numFrames *= 2;
+    }
+
+    return const_cast<float*>(input);
+}
+
+void HalfbandOversampler::processSamplesDown(float* const* channels, int numChannels, int numSamples) {
+    numChannels = std::min(numChannels, mNumChannels);
+    int numStages = (int)mStages.size();
+    if (numStages == 0)
+        return;
+
+    //top buffer is where the last up stage wrote
+    int numFrames = numSamples << numStages;
+    const float* input = mBuffers[(numStages - 1) % 2].data();
+    for (int stage = numStages - 1; stage >= 0; stage--) {
+        numFrames /= 2;
+        float* output = stage > 0 ? mBuffers[(stage - 1) % 2].data() : mInterleaved.data();
+        mStages[stage].downsample(input, output, numFrames, numChannels);
+        input = output;
+    }
+
+    //deinterleave
+    const float* interleaved = mInterleaved.data();
+    for (int channel = 0; channel < numChannels; channel++) {
+        float* data = channels[channel];
+        for (int i = 0; i < numSamples; i++)
+            data[i] = interleaved[i * numChannels + channel];
+    }
+}
@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    HalfbandOversampler.h
+    Created: 19 Oct 2026 2:41:06pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <vector>
+
+//one 2x polyphase IIR halfband stage (two allpass paths)
+//channels are interleaved, a frame of both paths is [path a channels, path b channels] padded up to whole SIMD registers
+//each register runs both paths for its lanes, so one pass down the coefficient pairs filters every channel at once
+//each allpass still depends on the one before it, the cost is the number of pairs per register per sample
+class HalfbandStage {
+public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    //elliptic halfband, transition is normalised to the higher rate (passband up to (0.25 - transition / 2) * fs)
+    void design(double attenuationDb, double transition);
+    void prepare(int numChannels);
+    void reset();
+
+    //input numFrames frames, output numFrames * 2 frames
+    //frames hold numChannels, the first lanes of what was prepared
+    void upsample(const float* input, float* output, int numFrames, int numChannels);
+    //input numFrames * 2 frames, output numFrames frames
+    void downsample(const float* input, float* output, int numFrames, int numChannels);
+    //copies the first channel's state into every other channel
+    void syncToFirstChannel();
+
+private:
+    //NumChannels 0 = the run time numChannels
+    template <int NumChannels> void processFrames(const Vec* coefs, Vec* x, Vec* y, int numFrames, int numChannels);
+    template <int NumChannels> void upsampleFrames(const float* input, float* output, int numFrames, int numChannels);
+    template <int NumChannels> void downsampleFrames(const float* input, float* output, int numFrames, int numChannels);
+
+    static int getNumVecs(int numChannels) { return (numChannels * 2 + (int)Vec::SIMDNumElements - 1) / (int)Vec::SIMDNumElements; }
+    //coefs per lane, up has path 0 (even coefs) in the first half, down has it in the second half like its input
+    void fillCoefs(std::vector<Vec>& coefs, bool pathZeroFirst) const;
+
+    std::vector<float> mCoefs;
+    int mNumChannels = 0;
+    int mNumVecs = 0;
+
+    //[pair][register]
+    std::vector<Vec> mUpCoefs, mDownCoefs;
+    //allpass states [pair][register], x = last input, y = last output
+    std::vector<Vec> mUpX, mUpY;
+    std::vector<Vec> mDownX, mDownY;
+
+    //frames are gathered into registers a chunk at a time, filtered, then scattered back out
+    //filling a register from scalar stores right before loading it stalls, a chunk apart it doesn't
+    static constexpr int chunkFrames = 64;
+    std::vector<Vec> mFrames;
+};
+
+//cascade of halfband stages, each one doubles the rate
+//takes planar channels in and hands out one interleaved oversampled buffer
+class HalfbandOversampler {
+public:
+    //numStages 1 = 2x, 2 = 4x, 3 = 8x
+    void prepare(int numStages, int numChannels, int maxBlockSize);
+    void reset();
+    int getFactor() const { return 1 << (int)mStages.size(); }
+    //group delay at DC of a full up/down pass, in host samples
+    double getLatencyInSamples() const { return mLatency; }
+
+    //returns interleaved data, numSamples * getFactor() frames of numChannels
+    float* processSamplesUp(const float* const* channels, int numChannels, int numSamples);
+    //filters the interleaved data back down into the planar channels
+    void processSamplesDown(float* const* channels, int numChannels, int numSamples);
+    //copies the first channel's state into every other channel
+    void syncToFirstChannel();
+
+private:
+    double measureLatency() const;
+
+    std::vector<HalfbandStage> mStages;
+    int mNumChannels = 0;
+    double mLatency = 0.0;
+
+    //host rate interleaved frames
+    std::vector<float> mInterleaved;
+    //ping pong buffers sized for the top rate
+    std::vector<float> mBuffers[2];
+};
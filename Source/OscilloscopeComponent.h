@@ -11,58 +11,156 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ScopeFifo.h"
 
-class RingBuffer; 
-
+//scope of the last 100ms, drawn as a min/max envelope (with the rms inside it) per pixel column
+//columns are worked out as the samples arrive, so painting only depends on the width
 class OscilloscopeComponent : public juce::Component,
     private juce::Timer
 {
 public:
-    OscilloscopeComponent(RingBuffer& bufferToUse)
-        : ringBuffer(bufferToUse)
+    OscilloscopeComponent(ScopeFifo& fifoToUse)
+        : scopeFifo(fifoToUse)
     {
-        displayBuffer.resize(ringBuffer.size());
+        //fills its whole area, so its repaints never reach the editor behind it
+        setOpaque(true);
+        scopeFifo.setActive(true);
         startTimerHz(60);
     }
 
+    ~OscilloscopeComponent() override
+    {
+        stopTimer();
+        scopeFifo.setActive(false);
+    }
+
     void paint(juce::Graphics& g) override
     {
         g.fillAll(juce::Colour(0xff323940));
-        g.setColour(juce::Colour(0xff82585b));
-        int height = getBounds().getHeight();
-        int midHeight = height / 2;
-        int scale = 90;
-        int width = getBounds().getWidth();
-        if (displayBuffer.size() > 0) {
-            int step = static_cast<int>(displayBuffer.size() / width);
-            int xPos = 0;
-            int yPos = midHeight - displayBuffer[0] * scale;
-            int nextX, nextY;
-            for (int i = step; i < displayBuffer.size(); i += step) {
-                nextX = xPos + 1;
-                nextY = midHeight - displayBuffer[i] * scale;
-                g.drawLine(xPos, yPos, nextX, nextY);
-                xPos = nextX;
-                yPos = nextY;
-            }
+
+        int numColumns = (int)displayColumns.size();
+        if (numColumns == 0)
+            return;
+
+        float midHeight = getHeight() / 2.0f;
+        const float scale = 90.0f;
+
+        //top edge left to right, bottom edge back again, one fill each
+        juce::Path envelope, rms;
+        envelope.preallocateSpace(numColumns * 6 + 3);
+        rms.preallocateSpace(numColumns * 6 + 3);
+        envelope.startNewSubPath(0.0f, midHeight - displayColumns[0].max * scale);
+        rms.startNewSubPath(0.0f, midHeight - displayColumns[0].rms * scale);
+        for (int x = 1; x < numColumns; x++) {
+            envelope.lineTo((float)x, midHeight - displayColumns[x].max * scale);
+            rms.lineTo((float)x, midHeight - displayColumns[x].rms * scale);
+        }
+        //at least a pixel thick so silence still shows a line
+        for (int x = numColumns - 1; x >= 0; x--) {
+            envelope.lineTo((float)x, std::max(midHeight - displayColumns[x].min * scale, midHeight - displayColumns[x].max * scale + 1.0f));
+            rms.lineTo((float)x, midHeight + displayColumns[x].rms * scale);
         }
+        envelope.closeSubPath();
+        rms.closeSubPath();
+
+        g.setColour(juce::Colour(0xff82585b));
+        g.fillPath(envelope);
+        g.setColour(juce::Colour(0xff82585b).brighter(0.4f));
+        g.fillPath(rms);
+    }
+
+    void resized() override
+    {
+        startView();
+        displayColumns.assign(std::max(0, getWidth()), Column{});
     }
 
 private:
+    struct Column {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+    };
+
     void timerCallback() override
     {
-        while (ringBuffer.hasNewData()) {
-            displayBuffer[mPos] = ringBuffer.read();
-            mPos++;
-            if (mPos >= displayBuffer.size()) {
-                repaint();
-                mPos = 0;
-                break;
+        //sample rate changed, start a fresh view
+        if (viewLength != scopeFifo.getViewLength())
+            startView();
+
+        int numColumns = (int)columns.size();
+        if (numColumns == 0) {
+            //nowhere to draw, keep the fifo from filling up
+            while (scopeFifo.read(readBuffer, readBufferSize) > 0) {}
+            return;
+        }
+
+        int numRead;
+        while ((numRead = scopeFifo.read(readBuffer, readBufferSize)) > 0) {
+            //each column takes its share of the chunk in one min/max pass
+            for (int done = 0; done < numRead;) {
+                int columnEnd = (int)((juce::int64)(column + 1) * viewLength / numColumns);
+                int numToTake = std::min(numRead - done, columnEnd - sampleInView);
+                const float* data = readBuffer + done;
+
+                if (numToTake > 0) {
+                    auto range = juce::FloatVectorOperations::findMinAndMax(data, numToTake);
+                    columnMin = std::min(columnMin, range.getStart());
+                    columnMax = std::max(columnMax, range.getEnd());
+                    for (int i = 0; i < numToTake; i++)
+                        columnSquares += data[i] * data[i];
+                    columnCount += numToTake;
+                }
+                done += numToTake;
+                sampleInView += numToTake;
+
+                if (sampleInView == columnEnd) {
+                    //views shorter than the width leave some columns empty, they repeat the one before
+                    if (columnCount > 0)
+                        columns[column] = { columnMin, columnMax, std::sqrt(columnSquares / columnCount) };
+                    else
+                        columns[column] = column > 0 ? columns[column - 1] : Column{};
+                    columnMin = std::numeric_limits<float>::max();
+                    columnMax = std::numeric_limits<float>::lowest();
+                    columnSquares = 0.0f;
+                    columnCount = 0;
+
+                    if (++column == numColumns) {
+                        displayColumns.swap(columns);
+                        repaint();
+                        column = 0;
+                        sampleInView = 0;
+                    }
+                }
             }
         }
     }
 
-    int mPos = 0;
-    RingBuffer& ringBuffer;
-    std::vector<float> displayBuffer;
-};
\ No newline at end of file
+    //throws away the half built view, the last complete one stays on screen
+    void startView()
+    {
+        viewLength = scopeFifo.getViewLength();
+        columns.assign(std::max(0, getWidth()), Column{});
+        column = 0;
+        sampleInView = 0;
+        columnMin = std::numeric_limits<float>::max();
+        columnMax = std::numeric_limits<float>::lowest();
+        columnSquares = 0.0f;
+        columnCount = 0;
+    }
+
+    ScopeFifo& scopeFifo;
+    static constexpr int readBufferSize = 2048;
+    float readBuffer[readBufferSize] = {};
+
+    //view being built and the last finished one
+    std::vector<Column> columns;
+    std::vector<Column> displayColumns;
+    int viewLength = 0;
+    int column = 0;
+    int sampleInView = 0;
+    float columnMin = 0.0f;
+    float columnMax = 0.0f;
+    float columnSquares = 0.0f;
+    int columnCount = 0;
+};
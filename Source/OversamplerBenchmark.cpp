@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    OversamplerBenchmark.cpp
+    Created: 20 Oct 2026 9:12:40am
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+//halfband cascade against juce::dsp::Oversampling, up and back down at 2x/4x/8x
+//only built with MBDISTORTION_BENCHMARKS=1 in the preprocessor definitions
+//run the "Benchmarks" category with juce::UnitTestRunner, results go to the log
+#ifndef MBDISTORTION_BENCHMARKS
+ #define MBDISTORTION_BENCHMARKS 0
+#endif
+
+#if MBDISTORTION_BENCHMARKS
+
+#include <JuceHeader.h>
+#include "HalfbandOversampler.h"
+
+class OversamplerBenchmark : public juce::UnitTest {
+public:
+    OversamplerBenchmark() : juce::UnitTest("Oversampler", "Benchmarks") {}
+
+    void runTest() override {
+        //sub-block sized, that's what the processor hands the oversamplers
+        for (int numChannels : { 1, 2, 6 }) {
+            for (int numStages = 1; numStages <= 3; numStages++) {
+                beginTest(juce::String(numChannels) + " channels, " + juce::String(1 << numStages) + "x");
+
+                double halfband = timeHalfband(numStages, numChannels);
+                double iir = timeJuce(numStages, numChannels, juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR);
+                double fir = timeJuce(numStages, numChannels, juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple);
+
+                //ns per host sample per channel
+                logMessage("halfband " + juce::String(halfband, 1)
+                    + "  juce iir " + juce::String(iir, 1)
+                    + "  juce fir " + juce::String(fir, 1) + " ns");
+            }
+        }
+    }
+
+private:
+    static constexpr int blockSize = 64;
+    static constexpr int numBlocks = 20000;
+    static constexpr int numRuns = 5;
+
+    void fillNoise(juce::AudioBuffer<float>& buffer) {
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+            auto* data = buffer.getWritePointer(channel);
+            for (int i = 0; i < buffer.getNumSamples(); i++)
+                data[i] = mRandom.nextFloat() * 0.5f - 0.25f;
+        }
+    }
+
+    //best of a few runs, in ns per host sample per channel
+    template <typename Function>
+    double timeBlocks(int numChannels, Function&& processBlock) {
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < numRuns; run++) {
+            auto start = juce::Time::getHighResolutionTicks();
+            for (int block = 0; block < numBlocks; block++)
+                processBlock();
+            double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+            best = std::min(best, seconds * 1.0e9 / ((double)numBlocks * blockSize * numChannels));
+        }
+        return best;
+    }
+
+    double timeHalfband(int numStages, int numChannels) {
+        juce::AudioBuffer<float> buffer(numChannels, blockSize);
+        fillNoise(buffer);
+        HalfbandOversampler oversampler;
+        oversampler.prepare(numStages, numChannels, blockSize);
+
+        return timeBlocks(numChannels, [&] {
+            oversampler.processSamplesUp(buffer.getArrayOfReadPointers(), numChannels, blockSize);
+            oversampler.processSamplesDown(buffer.getArrayOfWritePointers(), numChannels, blockSize);
+        });
+    }
+
+    double timeJuce(int numStages, int numChannels, juce::dsp::Oversampling<float>::FilterType filterType) {
+        juce::AudioBuffer<float> buffer(numChannels, blockSize);
+        fillNoise(buffer);
+        juce::dsp::Oversampling<float> oversampler((size_t)numChannels, (size_t)numStages, filterType, true, false);
+        oversampler.initProcessing(blockSize);
+        oversampler.reset();
+
+        return timeBlocks(numChannels, [&] {
+            juce::dsp::AudioBlock<float> block(buffer);
+            oversampler.processSamplesUp(block);
+            oversampler.processSamplesDown(block);
+        });
+    }
+
+    juce::Random mRandom{ 1 };
+};
+
+static OversamplerBenchmark oversamplerBenchmark;
+
+#endif
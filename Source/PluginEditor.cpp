@@ -11,15 +11,13 @@
 
 //==============================================================================
 MBDistortionAudioProcessorEditor::MBDistortionAudioProcessorEditor(MBDistortionAudioProcessor& p)
-    : AudioProcessorEditor(&p), audioProcessor(p), oscilloscope(p.oscBuffer)
+    : AudioProcessorEditor(&p), audioProcessor(p), oscilloscope(p.oscBuffer), spectrum(p.spectrumAnalyzer)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
 
     setLookAndFeel(&customLookAndFeel);
 
-    audioProcessor.oscBuffer.resize(int(audioProcessor.getSampleRate() * 0.1));
-
     //band drive sliders
     addSliderRotary(band1Drive);
     band1DriveLabel.setText("Drive", juce::dontSendNotification);
@@ -62,8 +60,13 @@ MBDistortionAudioProcessorEditor::MBDistortionAudioProcessorEditor(MBDistortionA
     oversampleSelectorAttachment = std::make_unique<ComboBoxAttachment>(audioProcessor.parameters, "oversamplingFactor", oversampleSelector);
     oversampleSelector.setJustificationType(juce::Justification::centred);
     oversampleSelector.setText("Oversampling", juce::dontSendNotification);
+    addAndMakeVisible(oversampleLabel);
+    oversampleLabel.setJustificationType(juce::Justification::centred);
 
     addAndMakeVisible(oscilloscope);
+    addAndMakeVisible(spectrum);
+    //the analyzer only runs while there's an editor to show it
+    audioProcessor.spectrumAnalyzer.setActive(true);
 
     //global controls
     addSliderRotary(inputGainSlider);
@@ -155,6 +158,16 @@ MBDistortionAudioProcessorEditor::MBDistortionAudioProcessorEditor(MBDistortionA
     band3Selector.setText("Distortion Type", juce::dontSendNotification);
     band4Selector.setText("Distortion Type", juce::dontSendNotification);
 
+    //curve parameters, resolved once so the timer doesn't look them up by string
+    for (int band = 0; band < 4; band++) {
+        juce::String prefix = "band" + juce::String(band + 1);
+        mCurveParams[band].type = audioProcessor.parameters.getRawParameterValue(prefix + "type");
+        mCurveParams[band].drive = audioProcessor.parameters.getRawParameterValue(prefix + "drive");
+        mCurveParams[band].level = audioProcessor.parameters.getRawParameterValue(prefix + "level");
+        mCurveStates[band] = readCurveState(band);
+    }
+
+    setOpaque(true);
     setSize(1000, 800);
 
     startTimerHz(60);
@@ -163,99 +176,50 @@ MBDistortionAudioProcessorEditor::MBDistortionAudioProcessorEditor(MBDistortionA
 
 MBDistortionAudioProcessorEditor::~MBDistortionAudioProcessorEditor()
 {
+    audioProcessor.spectrumAnalyzer.setActive(false);
     setLookAndFeel(nullptr);
 }
 
 //==============================================================================
 void MBDistortionAudioProcessorEditor::paint(juce::Graphics& g)
+{
+    //panels come from the cached image, drawn again only after a resize or a move to another screen scale
+    float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    if (!mBackground.isValid() || scale != mBackgroundScale)
+        renderBackground(scale);
+    g.drawImage(mBackground, getLocalBounds().toFloat());
+
+    //curves were worked out when their parameters changed, only the ones in the dirty region are drawn
+    auto clip = g.getClipBounds();
+    for (int band = 0; band < 4; band++) {
+        if (clip.intersects(mCurveBounds[band]))
+            drawCharacteristicCurve(g, mCurveBounds[band], mCurvePaths[band]);
+    }
+}
+
+void MBDistortionAudioProcessorEditor::renderBackground(float scale)
 {
     //colours
     auto baseColour = juce::Colour(0xff2e2e2e);
     auto panelColour = juce::Colour(0xff323940);
     auto bandColumnColour = juce::Colour(0xff323940);
 
+    mBackgroundScale = scale;
+    mBackground = juce::Image(juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+        juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
+    juce::Graphics g(mBackground);
+    g.addTransform(juce::AffineTransform::scale(scale));
+
     //background
     g.fillAll(baseColour);
 
-    //padding, bounds, ara, etc
-    const int padding = 8;
-    auto bounds = getLocalBounds(); 
-    auto area = bounds.reduced(padding); 
-    auto initialArea = area;
-
-    int availableHeight = area.getHeight();
-
-    //section background
-
-    //oscilloscope 
-    auto topHeight = int(availableHeight * 0.25);
-    auto scopeSectionArea = area.removeFromTop(topHeight);
-    g.setColour(panelColour);
-    g.fillRect(scopeSectionArea);
-
-    //gap
-    area.removeFromTop(padding / 2);
-
-    //crossovers
-    auto crossoverHeight = int(availableHeight * 0.1f);
-    auto crossoverSectionArea = area.removeFromTop(crossoverHeight);
-    g.setColour(panelColour);
-    g.fillRect(crossoverSectionArea);
-
-    //gap
-    area.removeFromTop(padding / 2);
-
-    //global controls
-    auto globalHeight = int(availableHeight * 0.15);
-    auto globalSectionArea = area.removeFromTop(globalHeight);
+    //section backgrounds
     g.setColour(panelColour);
-    g.fillRect(globalSectionArea);
-
-    //gap
-    area.removeFromTop(padding / 2);
-
-    //band area
-    auto bandSectionArea = area;
+    g.fillRect(mScopePanel);
+    g.fillRect(mCrossoverPanel);
+    g.fillRect(mGlobalPanel);
     g.setColour(bandColumnColour);
-    g.fillRect(bandSectionArea);
-
-    //characteristic curves
-    auto totalBandAreaHeight = int(initialArea.getHeight() * 0.5);
-    auto bandWidth = initialArea.getWidth() / 4;
-
-    //parameters
-    float band1Drive = *audioProcessor.parameters.getRawParameterValue("band1drive");
-    float band1Level = *audioProcessor.parameters.getRawParameterValue("band1level");
-    float band1TypeFloat = *audioProcessor.parameters.getRawParameterValue("band1type");
-
-    float band2Drive = *audioProcessor.parameters.getRawParameterValue("band2drive");
-    float band2Level = *audioProcessor.parameters.getRawParameterValue("band2level");
-    float band2TypeFloat = *audioProcessor.parameters.getRawParameterValue("band2type");
-
-    float band3Drive = *audioProcessor.parameters.getRawParameterValue("band3drive");
-    float band3Level = *audioProcessor.parameters.getRawParameterValue("band3level");
-    float band3TypeFloat = *audioProcessor.parameters.getRawParameterValue("band3type");
-
-    float band4Drive = *audioProcessor.parameters.getRawParameterValue("band4drive");
-    float band4Level = *audioProcessor.parameters.getRawParameterValue("band4level");
-    float band4TypeFloat = *audioProcessor.parameters.getRawParameterValue("band4type");
-
-    int bandSectionY = bandSectionArea.getY();
-
-    auto charCurveHeight = int(totalBandAreaHeight * 0.4);
-    auto curvePadding = 4;
-
-    juce::Rectangle<int> charCurve1Bounds(bandSectionArea.getX(), bandSectionY, bandWidth, charCurveHeight);
-    juce::Rectangle<int> charCurve2Bounds(bandSectionArea.getX() + bandWidth, bandSectionY, bandWidth, charCurveHeight);
-    juce::Rectangle<int> charCurve3Bounds(bandSectionArea.getX() + bandWidth * 2, bandSectionY, bandWidth, charCurveHeight);
-    juce::Rectangle<int> charCurve4Bounds(bandSectionArea.getX() + bandWidth * 3, bandSectionY, bandWidth, charCurveHeight);
-
-    //draw curves
-    drawCharacteristicCurve(g, charCurve1Bounds.reduced(curvePadding), static_cast<DistortionTypes>(static_cast<int>(band1TypeFloat)), band1Drive, band1Level);
-    drawCharacteristicCurve(g, charCurve2Bounds.reduced(curvePadding), static_cast<DistortionTypes>(static_cast<int>(band2TypeFloat)), band2Drive, band2Level);
-    drawCharacteristicCurve(g, charCurve3Bounds.reduced(curvePadding), static_cast<DistortionTypes>(static_cast<int>(band3TypeFloat)), band3Drive, band3Level);
-    drawCharacteristicCurve(g, charCurve4Bounds.reduced(curvePadding), static_cast<DistortionTypes>(static_cast<int>(band4TypeFloat)), band4Drive, band4Level);
-
+    g.fillRect(mBandPanel);
 }
 
 void MBDistortionAudioProcessorEditor::resized()
@@ -269,10 +233,14 @@ void MBDistortionAudioProcessorEditor::resized()
 
     int availableHeight = area.getHeight();
 
-    //oscilloscope
+    //oscilloscope, spectrum of the selected band next to it
     auto topHeight = int(availableHeight * 0.25);
     auto scopeArea = area.removeFromTop(topHeight);
-    oscilloscope.setBounds(scopeArea.reduced(padding / 2));
+    mScopePanel = scopeArea;
+    auto scopeContent = scopeArea.reduced(padding / 2);
+    oscilloscope.setBounds(scopeContent.removeFromLeft(scopeContent.getWidth() / 2 - padding / 4));
+    scopeContent.removeFromLeft(padding / 2);
+    spectrum.setBounds(scopeContent);
 
     //gap
     area.removeFromTop(padding / 2);
@@ -280,6 +248,7 @@ void MBDistortionAudioProcessorEditor::resized()
     //crossovers
     auto crossoverHeight = int(availableHeight * 0.1);
     auto crossoverArea = area.removeFromTop(crossoverHeight);
+    mCrossoverPanel = crossoverArea;
     auto crossoverSliderWidth = crossoverArea.getWidth() / 3;
 
     auto crossover1Area = crossoverArea.removeFromLeft(crossoverSliderWidth);
@@ -300,6 +269,7 @@ void MBDistortionAudioProcessorEditor::resized()
     //global controls
     auto globalHeight = int(availableHeight * 0.15);
     auto globalArea = area.removeFromTop(globalHeight);
+    mGlobalPanel = globalArea;
     auto globalCtrlWidth = globalArea.getWidth() / 5; //5 global controls
 
     auto inputGainArea = globalArea.removeFromLeft(globalCtrlWidth);
@@ -319,6 +289,7 @@ void MBDistortionAudioProcessorEditor::resized()
     bypassButton.setBounds(bypassArea.reduced(padding / 2));
 
     auto oversampleArea = globalArea;
+    oversampleLabel.setBounds(oversampleArea.removeFromTop(bandLabelHeight).reduced(padding / 2));
     oversampleSelector.setBounds(oversampleArea.reduced(padding / 2));
 
     //gap
@@ -328,6 +299,19 @@ void MBDistortionAudioProcessorEditor::resized()
     auto bandSectionArea = area; 
     auto totalBandAreaHeight = bandSectionArea.getHeight();
     auto bandWidth = bandSectionArea.getWidth() / 4;
+    mBandPanel = bandSectionArea;
+
+    //characteristic curves, sized off the whole editor
+    auto curveBandWidth = initialArea.getWidth() / 4;
+    auto curveHeight = int(initialArea.getHeight() * 0.5 * 0.4);
+    auto curvePadding = 4;
+    for (int band = 0; band < 4; band++) {
+        mCurveBounds[band] = juce::Rectangle<int>(bandSectionArea.getX() + curveBandWidth * band, bandSectionArea.getY(),
+            curveBandWidth, curveHeight).reduced(curvePadding);
+        mCurvePaths[band] = makeCharacteristicCurve(mCurveBounds[band], mCurveStates[band]);
+    }
+    //panels are drawn again on the next paint
+    mBackground = {};
 
     //columns
     auto band1ColArea = bandSectionArea.removeFromLeft(bandWidth);
@@ -456,16 +440,42 @@ void MBDistortionAudioProcessorEditor::addFactorComboBox(juce::ComboBox& comboBo
     comboBox.addItem("2x", 2);
     comboBox.addItem("4x", 3);
     comboBox.addItem("8x", 4);
+    comboBox.addItem("Auto", 5);
 
     addAndMakeVisible(comboBox);
 }
 
 void MBDistortionAudioProcessorEditor::timerCallback() {
-    repaint();
+    //show what auto/governor actually picked
+    int effectiveFactor = audioProcessor.getEffectiveOversamplingFactor();
+    if (effectiveFactor != lastEffectiveFactor) {
+        lastEffectiveFactor = effectiveFactor;
+        oversampleLabel.setText(effectiveFactor > 1 ? "Running " + juce::String(effectiveFactor) + "x" : "Running Off",
+            juce::dontSendNotification);
+    }
+
+    //only a curve whose parameters moved is worked out and repainted
+    //the scope repaints itself, so an untouched editor does no drawing at all
+    for (int band = 0; band < 4; band++) {
+        CurveState state = readCurveState(band);
+        if (state != mCurveStates[band]) {
+            mCurveStates[band] = state;
+            mCurvePaths[band] = makeCharacteristicCurve(mCurveBounds[band], state);
+            repaint(mCurveBounds[band]);
+        }
+    }
+}
+
+MBDistortionAudioProcessorEditor::CurveState MBDistortionAudioProcessorEditor::readCurveState(int band) const {
+    CurveState state;
+    state.type = static_cast<DistortionTypes>(static_cast<int>(mCurveParams[band].type->load()));
+    state.drive = mCurveParams[band].drive->load();
+    state.level = mCurveParams[band].level->load();
+    return state;
 }
 
 void MBDistortionAudioProcessorEditor::drawCharacteristicCurve(juce::Graphics& g, juce::Rectangle<int> bounds,
-    DistortionTypes type, float drive, float level) {
+    const juce::Path& curve) {
     
     //style stuff
     auto curveBgColour = juce::Colour(0xff323940);
@@ -475,14 +485,6 @@ void MBDistortionAudioProcessorEditor::drawCharacteristicCurve(juce::Graphics& g
     //set background
     g.setColour(curveBgColour);
     g.fillRect(bounds);
-    
-    //convert to gain
-    float driveGain = pow(10, drive / 20.0f);
-    float levelGain = pow(10, level / 20.0f);
-
-    //temp processors
-    DistortionProcessor tempDistortion;
-    tempDistortion.setDistortionType(type);
 
     const float inputMin = -1.0f;
     const float inputMax = 1.0f;
@@ -500,6 +502,25 @@ void MBDistortionAudioProcessorEditor::drawCharacteristicCurve(juce::Graphics& g
     xZero = juce::jlimit((float)bounds.getX(), (float)bounds.getRight(), xZero);
     g.drawLine(xZero, (float)bounds.getY(), xZero, (float)bounds.getBottom(), 0.8f); 
 
+    g.setColour(curveColour);
+    g.strokePath(curve, juce::PathStrokeType(1.8f)); 
+}
+
+//one point per pixel through the band's curve
+juce::Path MBDistortionAudioProcessorEditor::makeCharacteristicCurve(juce::Rectangle<int> bounds, const CurveState& state) const {
+    //convert to gain
+    float driveGain = pow(10, state.drive / 20.0f);
+    float levelGain = pow(10, state.level / 20.0f);
+
+    //temp processors
+    DistortionProcessor tempDistortion;
+    tempDistortion.setDistortionType(state.type);
+
+    const float inputMin = -1.0f;
+    const float inputMax = 1.0f;
+    const float displayOutputMin = -1.2f;
+    const float displayOutputMax = 1.2f;
+
     juce::Path path;
     const int numPoints = bounds.getWidth(); 
     bool firstPoint = true;
@@ -511,7 +532,7 @@ void MBDistortionAudioProcessorEditor::drawCharacteristicCurve(juce::Graphics& g
 
         float drivenInput = currentInput;
 
-        if (type != DistortionTypes::None)
+        if (state.type != DistortionTypes::None)
             drivenInput *= driveGain;
 
         float processedSample = tempDistortion.processSample(drivenInput);
@@ -534,9 +555,7 @@ void MBDistortionAudioProcessorEditor::drawCharacteristicCurve(juce::Graphics& g
         }
     }
 
-    g.setColour(curveColour);
-    g.strokePath(path, juce::PathStrokeType(1.8f)); 
-
+    return path;
 }
 
 CustomLookAndFeel::CustomLookAndFeel() {
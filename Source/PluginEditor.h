@@ -11,6 +11,7 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 #include "OscilloscopeComponent.h"
+#include "SpectrumComponent.h"
 #include "CustomLookAndFeel.h"
 
 //==============================================================================
@@ -41,6 +42,7 @@ private:
     // access the processor object that created it.
     MBDistortionAudioProcessor& audioProcessor;
     OscilloscopeComponent oscilloscope;
+    SpectrumComponent spectrum;
 
     //band sliders 'drive'
     juce::Slider band1Drive, band2Drive, band3Drive, band4Drive;
@@ -107,11 +109,37 @@ private:
     //oversample selector
     juce::ComboBox oversampleSelector;
     juce::Label oversampleLabel;
+    int lastEffectiveFactor = 0;
     std::unique_ptr<ComboBoxAttachment> oversampleSelectorAttachment;
 
     //characteristic curve dispaly
-    void drawCharacteristicCurve(juce::Graphics& g, juce::Rectangle<int> bounds,
-        DistortionTypes type, float drive, float level);
+    //a curve is only worked out again, and its area repainted, when its band's type, drive or level moves
+    struct CurveState {
+        DistortionTypes type = DistortionTypes::None;
+        float drive = 0.0f;
+        float level = 0.0f;
+        bool operator!=(const CurveState& other) const {
+            return type != other.type || drive != other.drive || level != other.level;
+        }
+    };
+    struct CurveParameters {
+        std::atomic<float>* type = nullptr;
+        std::atomic<float>* drive = nullptr;
+        std::atomic<float>* level = nullptr;
+    };
+    CurveParameters mCurveParams[4];
+    CurveState mCurveStates[4];
+    juce::Path mCurvePaths[4];
+    juce::Rectangle<int> mCurveBounds[4];
+    CurveState readCurveState(int band) const;
+    juce::Path makeCharacteristicCurve(juce::Rectangle<int> bounds, const CurveState& state) const;
+    void drawCharacteristicCurve(juce::Graphics& g, juce::Rectangle<int> bounds, const juce::Path& curve);
+
+    //panels only change on resize, so they're drawn once into an image at the screen's pixel scale
+    juce::Rectangle<int> mScopePanel, mCrossoverPanel, mGlobalPanel, mBandPanel;
+    juce::Image mBackground;
+    float mBackgroundScale = 0.0f;
+    void renderBackground(float scale);
 
     //custom look and feel
     CustomLookAndFeel customLookAndFeel;
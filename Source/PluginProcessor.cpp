@@ -9,6 +9,25 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+//parameters behind each dirty flag
+namespace {
+    const char* const gainParameterIDs[] = {
+        "band1drive", "band2drive", "band3drive", "band4drive",
+        "band1level", "band2level", "band3level", "band4level",
+        "band1solo", "band2solo", "band3solo", "band4solo",
+        "band1mute", "band2mute", "band3mute", "band4mute",
+        "inputGain", "outputGain", "masterMix"
+    };
+
+    const char* const typeParameterIDs[] = {
+        "band1type", "band2type", "band3type", "band4type"
+    };
+
+    const char* const crossoverParameterIDs[] = {
+        "crossoverFreq1", "crossoverFreq2", "crossoverFreq3"
+    };
+}
+
 //==============================================================================
 MBDistortionAudioProcessor::MBDistortionAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -22,10 +41,52 @@ MBDistortionAudioProcessor::MBDistortionAudioProcessor()
                        )
 #endif
 {
+    //resolve parameter pointers once
+    for (int band = 0; band < 4; band++) {
+        juce::String prefix = "band" + juce::String(band + 1);
+        mParams.bandDrive[band] = parameters.getRawParameterValue(prefix + "drive");
+        mParams.bandLevel[band] = parameters.getRawParameterValue(prefix + "level");
+        mParams.bandType[band] = parameters.getRawParameterValue(prefix + "type");
+        mParams.bandSolo[band] = parameters.getRawParameterValue(prefix + "solo");
+        mParams.bandMute[band] = parameters.getRawParameterValue(prefix + "mute");
+    }
+    for (int i = 0; i < 3; i++)
+        mParams.crossoverFreq[i] = parameters.getRawParameterValue("crossoverFreq" + juce::String(i + 1));
+
+    mParams.inputGain = parameters.getRawParameterValue("inputGain");
+    mParams.outputGain = parameters.getRawParameterValue("outputGain");
+    mParams.masterMix = parameters.getRawParameterValue("masterMix");
+    mParams.bypass = parameters.getRawParameterValue("bypass");
+    mParams.oversamplingFactor = parameters.getRawParameterValue("oversamplingFactor");
+    mParams.cpuGovernor = parameters.getRawParameterValue("cpuGovernor");
+    mParams.cpuBudget = parameters.getRawParameterValue("cpuBudget");
+    mParams.multiThreading = parameters.getRawParameterValue("multiThreading");
+    mParams.monoBass = parameters.getRawParameterValue("monoBass");
+    mParams.multirate = parameters.getRawParameterValue("multirate");
+    mParams.internalBlockSize = parameters.getRawParameterValue("internalBlockSize");
+    mParams.truePeakLimiter = parameters.getRawParameterValue("truePeakLimiter");
+    mParams.limiterCeiling = parameters.getRawParameterValue("limiterCeiling");
+
+    //dirty flags
+    for (auto* id : gainParameterIDs)
+        parameters.addParameterListener(id, &mGainsDirty);
+    for (auto* id : typeParameterIDs)
+        parameters.addParameterListener(id, &mTypesDirty);
+    for (auto* id : crossoverParameterIDs)
+        parameters.addParameterListener(id, &mCrossoverDirty);
+
+    startTimer(serviceIntervalMs);
 }
 
 MBDistortionAudioProcessor::~MBDistortionAudioProcessor()
 {
+    stopTimer();
+    for (auto* id : gainParameterIDs)
+        parameters.removeParameterListener(id, &mGainsDirty);
+    for (auto* id : typeParameterIDs)
+        parameters.removeParameterListener(id, &mTypesDirty);
+    for (auto* id : crossoverParameterIDs)
+        parameters.removeParameterListener(id, &mCrossoverDirty);
 }
 
 //==============================================================================
@@ -113,9 +174,44 @@ juce::AudioProcessorValueTreeState::ParameterLayout MBDistortionAudioProcessor::
         std::make_unique<juce::AudioParameterChoice>(
             juce::ParameterID("oversamplingFactor", 1),
             "Oversampling",
-            juce::StringArray{"Off", "2x", "4x", "8x"},
+            juce::StringArray{"Off", "2x", "4x", "8x", "Auto"},
             0), //default "Off"
 
+        //cpu governor, steps oversampling down when blocks run over budget
+        std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("cpuGovernor", 1), "CPU Governor", false),
+        std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID("cpuBudget", 1), "CPU Budget",
+            juce::NormalisableRange<float>(10.0f, 100.0f, 1.0f, 1.0f),
+            50.0f, "%"),
+
+        //low band summed to mono and processed once for every channel
+        std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("monoBass", 1), "Mono Bass", false),
+
+        //low bands shaped at the lowest factor their harmonics need instead of the global one
+        std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("multirate", 1), "Multirate Bands", false),
+
+        //true peak limiter on the output, adds about 1ms of latency
+        std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("truePeakLimiter", 1), "True Peak Limiter", false),
+        std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID("limiterCeiling", 1), "Limiter Ceiling",
+            juce::NormalisableRange<float>(-12.0f, 0.0f, 0.1f, 1.0f),
+            -1.0f, "dBTP"),
+
+        //fixed internal blocks for hosts with tiny or irregular buffers, adds one block of latency
+        std::make_unique<juce::AudioParameterChoice>(
+            juce::ParameterID("internalBlockSize", 1),
+            "Internal Block Size",
+            juce::StringArray{"Host", "64", "128"},
+            0), //default "Host"
+
+        //spreads bands and channels over worker threads on big host blocks
+        std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("multiThreading", 1), "Multi-Threading", false),
+
         //band levels
         std::make_unique<juce::AudioParameterFloat>(
             juce::ParameterID("band1level", 1), "Low Band Level",
@@ -218,9 +314,9 @@ void MBDistortionAudioProcessor::prepareToPlay (double sampleRate, int samplesPe
     mHostSampleRate = sampleRate;
 
     //inital crossoverfreqs
-    float targetFreq1 = *parameters.getRawParameterValue("crossoverFreq1");
-    float targetFreq2 = *parameters.getRawParameterValue("crossoverFreq2");
-    float targetFreq3 = *parameters.getRawParameterValue("crossoverFreq3");
+    float targetFreq1 = *mParams.crossoverFreq[0];
+    float targetFreq2 = *mParams.crossoverFreq[1];
+    float targetFreq3 = *mParams.crossoverFreq[2];
 
     //enforce min separation
     //no lower than 20hz
@@ -236,68 +332,160 @@ void MBDistortionAudioProcessor::prepareToPlay (double sampleRate, int samplesPe
     lastCrossoverFreq2 = targetFreq2;
     lastCrossoverFreq3 = targetFreq3;
 
-    //effective sample rate
-    double effectiveSampleRate = getEffectiveSampleRate();
-
     //get num channels
     int numChannels = getNumInputChannels();
 
     //update oversample factor first
     updateOversamplefactor();
 
-    int oversampleStage = 0;
-    if (mCurrentOversamplingFactor == 2) oversampleStage = 1;
-    else if (mCurrentOversamplingFactor == 4) oversampleStage = 2;
-    else if (mCurrentOversamplingFactor == 8) oversampleStage = 3;
-
     //setup oversamplers
-    mOversample.clear();
-
-    //create oversampler objects
-    for (int channel = 0; channel < numChannels; channel++) {
-        auto oversampler = std::make_unique<juce::dsp::Oversampling<float>>(
-            1, oversampleStage, juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR);
-        oversampler->initProcessing(static_cast<size_t>(samplesPerBlock));
-        mOversample.push_back(std::move(oversampler));
-    }
+    //every factor is allocated here so auto can switch without allocating
+    //they only ever see one sub-block, whatever block size the host announced or sends
+    for (auto& bandOversample : mBandOversample)
+        bandOversample.prepare(numChannels, controlBlockSize);
+    mMonoBandOversample.prepare(1, controlBlockSize);
+    mLinearOversample.prepare(numChannels, controlBlockSize);
+
+    //auto starts safe at 8x and steps down once it has seen the signal
+    if (mAutoOversampling)
+        mCurrentOversamplingFactor = 8;
+    mAutoHoldSamples = 0;
+    setOversamplingFactor(mCurrentOversamplingFactor);
+    updateBandFactors();
+    for (auto& bandOversample : mBandOversample)
+        bandOversample.reset();
+    mMonoBandOversample.reset();
+    mLinearOversample.reset();
+
+    //scratch buffers, all carved from one aligned arena and sized for a sub-block
+    //first pass measures, second hands out the memory
+    for (auto& bandChannels : mBandChannels)
+        bandChannels.resize(numChannels);
+    mDryChannels.resize(numChannels);
+    mCollapseChannels.resize(numChannels);
+    mArena.beginLayout();
+    layoutScratch(numChannels);
+    mArena.allocate();
+    layoutScratch(numChannels);
+
+    //band buffers hold the split signal at host rate
+    for (int band = 0; band < 4; band++)
+        mBandBuffers[band].setDataToReferTo(mBandChannels[band].data(), numChannels, controlBlockSize);
+    mRampBuffer.setDataToReferTo(mRampChannels.data(), numRamps, controlBlockSize);
+    mDryBuffer.setDataToReferTo(mDryChannels.data(), numChannels, controlBlockSize);
+    mCollapseBuffer.setDataToReferTo(mCollapseChannels.data(), numChannels, controlBlockSize);
+    mMonoBandBuffer.setDataToReferTo(&mMonoBandChannel, 1, controlBlockSize);
 
     //initalise all filter objects
-    mLowBandLP.resize(numChannels);
-    mLowMidBandHP.resize(numChannels);
-    mLowMidBandLP.resize(numChannels);
-    mHighMidBandHP.resize(numChannels);
-    mHighMidBandLP.resize(numChannels);
-    mHighBandHP.resize(numChannels);
-
-    for (int channel = 0; channel < numChannels; ++channel) {
-  
-        mLowBandLP[channel].setSampleRate(effectiveSampleRate);
-        mLowMidBandHP[channel].setSampleRate(effectiveSampleRate);
-        mLowMidBandLP[channel].setSampleRate(effectiveSampleRate);
-        mHighMidBandHP[channel].setSampleRate(effectiveSampleRate);
-        mHighMidBandLP[channel].setSampleRate(effectiveSampleRate);
-        mHighBandHP[channel].setSampleRate(effectiveSampleRate);
-
-        mLowBandLP[channel].setCutoff(lastCrossoverFreq1);
-        mLowMidBandHP[channel].setCutoff(lastCrossoverFreq1);
-
-        mLowMidBandLP[channel].setCutoff(lastCrossoverFreq2);
-        mHighMidBandHP[channel].setCutoff(lastCrossoverFreq2);
-
-        mHighMidBandLP[channel].setCutoff(lastCrossoverFreq3);
-        mHighBandHP[channel].setCutoff(lastCrossoverFreq3);
-
-        mLowBandLP[channel].reset();
-        mLowMidBandHP[channel].reset();
-        mLowMidBandLP[channel].reset();
-        mHighMidBandHP[channel].reset();
-        mHighMidBandLP[channel].reset();
-        mHighBandHP[channel].reset();
+    //one bank per crossover filter, every channel of the bus runs through it together
+    mLowBandLP.prepare(LinkwitzRileyBank::Type::LowPass, numChannels);
+    mLowMidBandHP.prepare(LinkwitzRileyBank::Type::HighPass, numChannels);
+    mLowMidBandLP.prepare(LinkwitzRileyBank::Type::LowPass, numChannels);
+    mHighMidBandHP.prepare(LinkwitzRileyBank::Type::HighPass, numChannels);
+    mHighMidBandLP.prepare(LinkwitzRileyBank::Type::LowPass, numChannels);
+    mHighBandHP.prepare(LinkwitzRileyBank::Type::HighPass, numChannels);
+
+    mLowBandLP.setSampleRate(mHostSampleRate);
+    mLowMidBandHP.setSampleRate(mHostSampleRate);
+    mLowMidBandLP.setSampleRate(mHostSampleRate);
+    mHighMidBandHP.setSampleRate(mHostSampleRate);
+    mHighMidBandLP.setSampleRate(mHostSampleRate);
+    mHighBandHP.setSampleRate(mHostSampleRate);
+
+    mLowBandLP.setCutoff(lastCrossoverFreq1);
+    mLowMidBandHP.setCutoff(lastCrossoverFreq1);
+
+    mLowMidBandLP.setCutoff(lastCrossoverFreq2);
+    mHighMidBandHP.setCutoff(lastCrossoverFreq2);
+
+    mHighMidBandLP.setCutoff(lastCrossoverFreq3);
+    mHighBandHP.setCutoff(lastCrossoverFreq3);
+
+    mLowBandLP.reset();
+    mLowMidBandHP.reset();
+    mLowMidBandLP.reset();
+    mHighMidBandHP.reset();
+    mHighMidBandLP.reset();
+    mHighBandHP.reset();
+
+    //mono bass low band, one channel
+    mMonoLowBandLP.prepare(LinkwitzRileyBank::Type::LowPass, 1);
+    mMonoLowBandLP.setSampleRate(mHostSampleRate);
+    mMonoLowBandLP.setCutoff(lastCrossoverFreq1);
+    mMonoLowBandLP.reset();
+    mMonoBassSmoothed.reset(sampleRate, monoBassRampSeconds);
+    mMonoBassSmoothed.setCurrentAndTargetValue(*mParams.monoBass > 0.5f && numChannels > 1 ? 1.0f : 0.0f);
+
+    //the split summed back up as one filter, used while every band is neutral
+    //designed right here, anything still on its way is for the old setup and gets dropped
+    mCollapse.prepare(numChannels);
+    mCollapseRequested.store(false, std::memory_order_relaxed);
+    auto collapseDesign = CollapsedCrossover::design(mHostSampleRate, lastCrossoverFreq1, lastCrossoverFreq2, lastCrossoverFreq3);
+    mCollapse.setDesign(collapseDesign);
+    mCollapseValid = collapseDesign.valid;
+    mCollapse.reset();
+    mCollapseHistory.assign(numChannels, {});
+
+    //everything derived gets worked out again for the new setup
+    mGainsDirty.markDirty();
+    mTypesDirty.markDirty();
+    mCrossoverDirty.markDirty();
+    updateDerivedParameters();
+
+    //gain smoothing, starts on the current values so there's no ramp on load
+    mInputGainSmoothed.reset(sampleRate, gainRampSeconds);
+    mInputGainSmoothed.setCurrentAndTargetValue(mDerived.inputGain);
+    mOutputGainSmoothed.reset(sampleRate, gainRampSeconds);
+    mOutputGainSmoothed.setCurrentAndTargetValue(mDerived.outputGain);
+    for (int band = 0; band < 4; band++) {
+        mBandDriveSmoothed[band].reset(sampleRate, gainRampSeconds);
+        mBandWetSmoothed[band].reset(sampleRate, gainRampSeconds);
+        mBandLinearSmoothed[band].reset(sampleRate, gainRampSeconds);
     }
+    setGainTargets();
+    for (int band = 0; band < 4; band++) {
+        mBandDriveSmoothed[band].setCurrentAndTargetValue(mBandDriveSmoothed[band].getTargetValue());
+        mBandWetSmoothed[band].setCurrentAndTargetValue(mBandWetSmoothed[band].getTargetValue());
+        mBandLinearSmoothed[band].setCurrentAndTargetValue(mBandLinearSmoothed[band].getTargetValue());
+    }
+
+    //bypass crossfade and the delay that lines the dry signal up with the processed one
+    mBypassSmoothed.reset(sampleRate, bypassRampSeconds);
+    mBypassSmoothed.setCurrentAndTargetValue(*mParams.bypass > 0.5f ? 1.0f : 0.0f);
+    mDryHistory.assign(numChannels, {});
+
+    //internal block fifo starts empty
+    mFifoBuffer.setSize(numChannels, maxFifoBlockSize);
+    mFifoBuffer.clear();
+    mFifoBlockSize = getRequestedFifoBlockSize();
+    mFifoPosition = 0;
+
+    mLimiter.prepare(sampleRate, numChannels);
+    mLimiterOn = *mParams.truePeakLimiter > 0.5f;
+    mPendingLatency.store(getTotalLatency(), std::memory_order_relaxed);
+    setLatencySamples(getTotalLatency());
+
+    //everything was just reset, the first block decides whether it's silent
+    //and whether it starts collapsed
+    mTailsSilent = false;
+    mIdle = false;
+    mChannelSettleSamples = (int)(sampleRate * channelSettleSeconds);
+    mIdenticalSamples = 0;
+    mChannelsInSync = true;
+    mDualMono = false;
+    mTreeRunning = true;
+    mCollapseRunning = false;
+    mCollapseSmoothed.reset(sampleRate, collapseRampSeconds);
+    mCollapseSmoothed.setCurrentAndTargetValue(0.0f);
+
+    //worker threads, only while multi-threading is on
+    mWorkersWanted = *mParams.multiThreading > 0.5f;
+    updateWorkerPool();
 
     //osc vis
-    //keep 100ms for audio
-    oscBuffer.resize(getSampleRate() * 0.1);
+    //one view is 100ms of audio, the fifo itself never changes size
+    oscBuffer.setViewLength((int)(sampleRate * 0.1));
+    spectrumAnalyzer.setSampleRate(sampleRate);
 
 }
 
@@ -305,6 +493,33 @@ void MBDistortionAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    const juce::SpinLock::ScopedLockType lock(mWorkerPoolLock);
+    mWorkerPool.stop();
+}
+
+void MBDistortionAudioProcessor::timerCallback()
+{
+    //follows the parameter itself, nothing happens while it's unchanged
+    updateWorkerPool();
+    //only notifies the host when it really changed
+    setLatencySamples(mPendingLatency.load(std::memory_order_relaxed));
+    if (mCollapseRequested.exchange(false, std::memory_order_acquire))
+        designCollapse();
+}
+
+//worker threads, parked until a block is big enough to share
+//one core is left for the host
+void MBDistortionAudioProcessor::updateWorkerPool() {
+    int numWorkers = *mParams.multiThreading > 0.5f
+        ? juce::jlimit(0, maxWorkers, juce::SystemStats::getNumCpus() - 1) : 0;
+    if (mWorkerPool.getNumWorkers() == numWorkers)
+        return;
+
+    const juce::SpinLock::ScopedLockType lock(mWorkerPoolLock);
+    if (numWorkers > 0)
+        mWorkerPool.start(numWorkers);
+    else
+        mWorkerPool.stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -315,11 +530,15 @@ bool MBDistortionAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
     return true;
   #else
     // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
+    // Mono, stereo and the surround layouts used in post.
     // Some plugin hosts, such as certain GarageBand versions, will only
     // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    const auto& outputSet = layouts.getMainOutputChannelSet();
+    if (outputSet != juce::AudioChannelSet::mono()
+     && outputSet != juce::AudioChannelSet::stereo()
+     && outputSet != juce::AudioChannelSet::create5point1()
+     && outputSet != juce::AudioChannelSet::create7point1()
+     && outputSet != juce::AudioChannelSet::create7point1point4())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -337,229 +556,571 @@ void MBDistortionAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
 {
     juce::ScopedNoDenormals noDenormals;
 
-    bool bypassOn = (*parameters.getRawParameterValue("bypass") > 0.5f);
-    
-    //oversampling
-    int previousFactor = mCurrentOversamplingFactor;
-    updateOversamplefactor();
-    if (previousFactor != mCurrentOversamplingFactor)
-        prepareToPlay(mHostSampleRate, buffer.getNumSamples());
-
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
+    int numSamples = buffer.getNumSamples();
 
     //clear other outputs
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
+        buffer.clear (i, 0, numSamples);
+
+    //worker threads come and go on the message thread (see timerCallback)
+    mWorkersWanted = *mParams.multiThreading > 0.5f;
+
+    //switching the fifo on or off starts it empty and tells the host about the new latency
+    int fifoBlockSize = getRequestedFifoBlockSize();
+    if (fifoBlockSize != mFifoBlockSize) {
+        mFifoBlockSize = fifoBlockSize;
+        mFifoPosition = 0;
+        mFifoBuffer.clear();
+        updateReportedLatency();
+    }
 
-    float targetFreq1 = *parameters.getRawParameterValue("crossoverFreq1");
-    float targetFreq2 = *parameters.getRawParameterValue("crossoverFreq2");
-    float targetFreq3 = *parameters.getRawParameterValue("crossoverFreq3");
-    double effectiveSampleRate = getEffectiveSampleRate();
+    //same for the limiter's look ahead
+    bool limiterOn = *mParams.truePeakLimiter > 0.5f;
+    if (limiterOn != mLimiterOn) {
+        mLimiterOn = limiterOn;
+        mLimiter.reset();
+        updateReportedLatency();
+    }
 
-    //enforce order & nyquist
-    targetFreq1 = std::clamp(targetFreq1, 20.0f, (float)(effectiveSampleRate / 2.0 * 0.95));
-    targetFreq2 = std::clamp(targetFreq2, targetFreq1 + minCrossoverFreq, (float)(effectiveSampleRate / 2.0 * 0.95));
-    targetFreq3 = std::clamp(targetFreq3, targetFreq2 + minCrossoverFreq, (float)(effectiveSampleRate / 2.0 * 0.95));
-    
-    if (targetFreq1 != lastCrossoverFreq1 || targetFreq2 != lastCrossoverFreq2 || targetFreq3 != lastCrossoverFreq3) {
+    if (mFifoBlockSize == 0) {
+        processInternalBlock(buffer);
+        return;
+    }
+
+    //each host sample swaps with the fifo slot holding its output from one block ago
+    //a full fifo is processed in place and becomes the next block's output
+    for (int done = 0; done < numSamples;) {
+        int numToSwap = std::min(numSamples - done, mFifoBlockSize - mFifoPosition);
         for (int channel = 0; channel < totalNumInputChannels; ++channel) {
-            mLowBandLP[channel].setCutoff(targetFreq1);
-            mLowMidBandHP[channel].setCutoff(targetFreq1);
+            float* hostData = buffer.getWritePointer(channel, done);
+            std::swap_ranges(hostData, hostData + numToSwap, mFifoBuffer.getWritePointer(channel, mFifoPosition));
+        }
+        done += numToSwap;
+        mFifoPosition += numToSwap;
 
-            mLowMidBandLP[channel].setCutoff(targetFreq2);
-            mHighMidBandHP[channel].setCutoff(targetFreq2);
+        if (mFifoPosition == mFifoBlockSize) {
+            juce::AudioBuffer<float> fifoBlock(mFifoBuffer.getArrayOfWritePointers(), totalNumInputChannels, mFifoBlockSize);
+            processInternalBlock(fifoBlock);
+            mFifoPosition = 0;
+        }
+    }
+}
 
-            mHighMidBandLP[channel].setCutoff(targetFreq3);
-            mHighBandHP[channel].setCutoff(targetFreq3);
+void MBDistortionAudioProcessor::processInternalBlock(juce::AudioBuffer<float>& buffer)
+{
+    //wall clock time of the whole block for the cpu governor
+    auto blockStartTicks = juce::Time::getHighResolutionTicks();
+
+    auto totalNumInputChannels = getTotalNumInputChannels();
+    int numSamples = buffer.getNumSamples();
+
+    //handing items to other threads only pays off on big blocks
+    //offline renders go by the same size, below it sharing is unmeasured and may well be slower
+    const juce::SpinLock::ScopedTryLockType workerPoolLock(mWorkerPoolLock);
+    bool useWorkers = mWorkersWanted && workerPoolLock.isLocked() && mWorkerPool.getNumWorkers() > 0
+        && numSamples >= minThreadedBlockSize;
+
+    //parameters are read and every control decision is made once per sub-block
+    //so automation and auto/bypass/idle timing don't depend on the host buffer size
+    //the sub-block refers to the host buffer, nothing is copied
+    for (int start = 0; start < numSamples; start += controlBlockSize) {
+        juce::AudioBuffer<float> subBlock(buffer.getArrayOfWritePointers(), totalNumInputChannels,
+            start, std::min(controlBlockSize, numSamples - start));
+
+        //dual mono
+        //the same signal on every channel with the same state gives the same output
+        //so only the first channel runs and gets copied to the rest
+        bool identical = channelsIdentical(subBlock);
+        if (mChannelsInSync && identical) {
+            juce::AudioBuffer<float> firstChannel(subBlock.getArrayOfWritePointers(), 1, subBlock.getNumSamples());
+            processSubBlock(firstChannel, useWorkers);
+            for (int channel = 1; channel < totalNumInputChannels; ++channel)
+                subBlock.copyFrom(channel, 0, subBlock, 0, 0, subBlock.getNumSamples());
+            mDualMono = true;
+            continue;
         }
 
-        lastCrossoverFreq1 = targetFreq1;
-        lastCrossoverFreq2 = targetFreq2;
-        lastCrossoverFreq3 = targetFreq3;
+        if (mDualMono) {
+            syncChannelStates();
+            mDualMono = false;
+        }
+        processSubBlock(subBlock, useWorkers);
+        //an idle block restarts every path clean, so the channels match again
+        //and identical input drives them together, the copy makes what's left of the difference exact
+        mIdenticalSamples = identical ? mIdenticalSamples + subBlock.getNumSamples() : 0;
+        mChannelsInSync = mIdle || mIdenticalSamples >= mChannelSettleSamples;
+        if (mChannelsInSync && !mIdle)
+            syncChannelStates();
     }
 
-    float band1Drive = pow(10, *parameters.getRawParameterValue("band1drive") / 20.0f);
-    float band2Drive = pow(10, *parameters.getRawParameterValue("band2drive") / 20.0f);
-    float band3Drive = pow(10, *parameters.getRawParameterValue("band3drive") / 20.0f);
-    float band4Drive = pow(10, *parameters.getRawParameterValue("band4drive") / 20.0f);
-
-    //set distortion types
-    lowBandDistortion.setDistortionType(static_cast<DistortionTypes>(int(*parameters.getRawParameterValue("band1type"))));
-    lowMidBandDistortion.setDistortionType(static_cast<DistortionTypes>(int(*parameters.getRawParameterValue("band2type"))));
-    highMidBandDistortion.setDistortionType(static_cast<DistortionTypes>(int(*parameters.getRawParameterValue("band3type"))));
-    highBandDistortion.setDistortionType(static_cast<DistortionTypes>(int(*parameters.getRawParameterValue("band4type"))));
-
-    //other params
-    //inputgain, outputgain, masterMix
-    float inputGain = pow(10, *parameters.getRawParameterValue("inputGain") / 20.0f);
-    float outputGain = pow(10, *parameters.getRawParameterValue("outputGain") / 20.0f);
-    float masterMix = *parameters.getRawParameterValue("masterMix");
-
-    //band levels
-    float band1Level = std::pow(10.0f, *parameters.getRawParameterValue("band1level") / 20.0f);
-    float band2Level = std::pow(10.0f, *parameters.getRawParameterValue("band2level") / 20.0f);
-    float band3Level = std::pow(10.0f, *parameters.getRawParameterValue("band3level") / 20.0f);
-    float band4Level = std::pow(10.0f, *parameters.getRawParameterValue("band4level") / 20.0f);
-
-    //SOLO&MUTE
-    bool solo[4] = {
-        *parameters.getRawParameterValue("band1solo") > 0.5f,
-        *parameters.getRawParameterValue("band2solo") > 0.5f,
-        *parameters.getRawParameterValue("band3solo") > 0.5f,
-        *parameters.getRawParameterValue("band4solo") > 0.5f
-    };
+    if (mLimiterOn) {
+        mLimiter.setCeiling(std::pow(10.0f, *mParams.limiterCeiling / 20.0f));
+        //bypassed it keeps its latency so the host's compensation still holds, but leaves the level alone
+        mLimiter.setBypassed(*mParams.bypass > 0.5f);
+        mLimiter.process(buffer.getArrayOfWritePointers(), totalNumInputChannels, numSamples);
+    }
 
-    bool mute[4] = {
-        *parameters.getRawParameterValue("band1mute") > 0.5f,
-        *parameters.getRawParameterValue("band2mute") > 0.5f,
-        *parameters.getRawParameterValue("band3mute") > 0.5f,
-        *parameters.getRawParameterValue("band4mute") > 0.5f
-    };
+    updateGovernor(juce::Time::highResolutionTicksToSeconds(
+        juce::Time::getHighResolutionTicks() - blockStartTicks), numSamples);
+    //collapsed means nothing is oversampled
+    mEffectiveOversamplingFactor.store(mFullyCollapsed ? 1 : mCurrentOversamplingFactor, std::memory_order_relaxed);
+}
 
-    bool anySolo = solo[0] || solo[1] || solo[2] || solo[3];
+int MBDistortionAudioProcessor::getRequestedFifoBlockSize() const {
+    switch ((int)*mParams.internalBlockSize) {
+    case 1: return 64;
+    case 2: return maxFifoBlockSize;
+    default: return 0; //host
+    }
+}
 
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
-    {
-        if (mCurrentOversamplingFactor > 1) {
-            auto& oversampler = *mOversample[channel];
-            //'buffer' is ORIGINAL BUFFER
-            auto channelBlock = juce::dsp::AudioBlock<float>(buffer).getSingleChannelBlock(channel);
-            auto upscaledBlock = oversampler.processSamplesUp(channelBlock);
-
-            //pointer to upsampled array
-            float* samples = upscaledBlock.getChannelPointer(0);
-            //number of samples in upsampled array
-            int numOversampled = static_cast<int>(upscaledBlock.getNumSamples());
-
-            if (bypassOn) {
-                for (int i = 0; i < numOversampled; i++)
-                    samples[i] *= inputGain;
-                oversampler.processSamplesDown(channelBlock);
-                continue;
-            }
+//the fifo delays everything by one block, the oversampling filters by the ceiling factor's group delay
+//and the limiter by its look ahead, the host compensates for all of it
+int MBDistortionAudioProcessor::getTotalLatency() const {
+    return mFifoBlockSize + mLinearOversample.getFactorLatency(mCeilingOversamplingFactor)
+        + (mLimiterOn ? mLimiter.getLatencyInSamples() : 0);
+}
 
-            //same sample for loop but with upsampledNumSamples
-            for (int i = 0; i < numOversampled; i++)
-            {
-                //overall input gain - NOT DRIVE
-                float input = samples[i] * inputGain;
+//setLatencySamples isn't realtime safe, so the audio thread only stores the new total
+//and the message thread passes it on (see timerCallback)
+void MBDistortionAudioProcessor::updateReportedLatency() {
+    mPendingLatency.store(getTotalLatency(), std::memory_order_relaxed);
+}
 
-                float low = mLowBandLP[channel].process(input);
-                float lowMid = mLowMidBandLP[channel].process(mLowMidBandHP[channel].process(input));
-                float highMid = mHighMidBandLP[channel].process(mHighMidBandHP[channel].process(input));
-                float high = mHighBandHP[channel].process(input);
+void MBDistortionAudioProcessor::processSubBlock(juce::AudioBuffer<float>& buffer, bool useWorkers)
+{
+    bool bypassOn = (*mParams.bypass > 0.5f);
+    
+    //oversampling
+    //fixed factors switch straight away, auto picks its factor once the bands are split
+    updateOversamplefactor();
+    if (!mAutoOversampling)
+        setOversamplingFactor(mCurrentOversamplingFactor);
+
+    auto totalNumInputChannels = buffer.getNumChannels();
+    int numSamples = buffer.getNumSamples();
+
+    //only recomputes what changed since the last block
+    updateCrossovers();
+    updateDerivedParameters();
+
+    DistortionProcessor* bandDistortion[4] = { &lowBandDistortion, &lowMidBandDistortion,
+        &highMidBandDistortion, &highBandDistortion };
+
+    //only the shaping bands need the extra bandwidth
+    //bands with no distortion are linear, so they get folded into the dry sum
+    //which is then split off as the 'linear' path
+    //a band that just stopped shaping keeps going until its wet gain has faded out
+    setGainTargets();
+    finishTypeChanges();
+
+    //band culling
+    //a silenced band (mute, solo elsewhere, or mix at 0) skips shaping once its wet gain has faded out
+    //and skips its filters too when the linear path doesn't need it either
+    bool shaping[4];
+    bool bandActive[4];
+    for (int band = 0; band < 4; band++) {
+        shaping[band] = (bandDistortion[band]->getType() != DistortionTypes::None
+            && mBandWetSmoothed[band].getTargetValue() != 0.0f)
+            || mBandWetSmoothed[band].isSmoothing();
+        bandActive[band] = shaping[band]
+            || mBandLinearSmoothed[band].getTargetValue() != 0.0f
+            || mBandLinearSmoothed[band].isSmoothing();
+    }
 
-                //specifically done to avoid phase issues when using dry/wet
-                //filters inherently introduce phase shifts
-                //so we cannot use the original input signal
-                float dryMix = low + lowMid + highMid + high;
+    //idle fast path
+    //silent input and every tail has died away, so there is nothing to work out
+    float inputPeak = 0.0f;
+    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+        inputPeak = std::max(inputPeak, buffer.getMagnitude(channel, 0, numSamples));
+    bool inputSilent = inputPeak < silenceThreshold;
+    bool idle = inputSilent && mTailsSilent;
+
+    if (idle) {
+        //gains jump to where they were heading, nothing audible to ramp
+        snapGainSmoothers();
+        mIdle = true;
+        mNumSkippedBlocks.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (mIdle) {
+        //signal is back, the filters start clean when they next run (see mTreeRunning)
+        for (auto& history : mDryHistory)
+            history.fill(0.0f);
+        mIdle = false;
+    }
 
-                //ACTUAL DRIVE
-                if (lowBandDistortion.getType() != DistortionTypes::None)
-                    low *= band1Drive;
+    //gain ramps for this block, nullptr when the gain is static
+    //ramps are worked out once per block and shared by every channel
+    const float* inputRamp = getGainRamp(mInputGainSmoothed, inputGainRamp, numSamples);
+    const float* outputRamp = getGainRamp(mOutputGainSmoothed, outputGainRamp, numSamples);
+
+    //bypass
+    //fully bypassed only delays the input to line up with the processed path
+    //toggling crossfades the two over a few ms
+    mBypassSmoothed.setTargetValue(bypassOn ? 1.0f : 0.0f);
+    if (idle)
+        mBypassSmoothed.setCurrentAndTargetValue(mBypassSmoothed.getTargetValue());
+    bool bypassFading = mBypassSmoothed.isSmoothing();
+    bool fullyBypassed = bypassOn && !bypassFading;
+    //every path is aligned to the ceiling factor, whatever it runs at right now
+    int dryDelay = mLinearOversample.getFactorLatency(mCeilingOversamplingFactor);
+
+    //mono bass
+    //the low band runs once on the channel average and goes back to every channel
+    //toggling crossfades the stereo and mono low band chains
+    //dual mono blocks run one channel of a multichannel bus, the average is still that channel
+    mMonoBassSmoothed.setTargetValue(*mParams.monoBass > 0.5f && getTotalNumInputChannels() > 1 ? 1.0f : 0.0f);
+    if (idle)
+        mMonoBassSmoothed.setCurrentAndTargetValue(mMonoBassSmoothed.getTargetValue());
+    bool monoFading = mMonoBassSmoothed.isSmoothing();
+    bool monoLow = monoFading || mMonoBassSmoothed.getTargetValue() == 1.0f;
+    bool stereoLow = monoFading || !monoLow;
+    bool monoActive = bandActive[0] && monoLow;
+    bool monoShaping = shaping[0] && monoLow;
+    bandActive[0] = bandActive[0] && stereoLow;
+    shaping[0] = shaping[0] && stereoLow;
+
+    //neutral collapse
+    //every band linear at the same gain, so the split and sum is one fixed filter
+    //the collapsed filter is delayed to line up with the oversampled split it replaces
+    bool neutral = mCollapseValid && !monoLow;
+    for (int band = 0; band < 4; band++) {
+        neutral = neutral && !shaping[band]
+            && !mBandLinearSmoothed[band].isSmoothing()
+            && mBandLinearSmoothed[band].getTargetValue() == mBandLinearSmoothed[0].getTargetValue();
+    }
+    mCollapseSmoothed.setTargetValue(neutral ? 1.0f : 0.0f);
+    if (idle)
+        mCollapseSmoothed.setCurrentAndTargetValue(mCollapseSmoothed.getTargetValue());
+    bool collapseFading = mCollapseSmoothed.isSmoothing();
+    mFullyCollapsed = neutral && !collapseFading;
+
+    if (idle) {
+        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+            buffer.clear(channel, 0, numSamples);
+        mTreeRunning = false;
+        mCollapseRunning = false;
+    }
+    else if (fullyBypassed) {
+        for (int channel = 0; channel < totalNumInputChannels; ++channel) {
+            auto* channelData = buffer.getWritePointer(channel);
+            applyGain(channelData, inputRamp, mInputGainSmoothed.getCurrentValue(), numSamples);
+            delayDry(channel, channelData, numSamples, dryDelay);
+        }
+        mTreeRunning = false;
+        mCollapseRunning = false;
+    }
+    else if (mFullyCollapsed && !bypassFading) {
+        //no split, no shaping, no oversampling, just the collapsed filter
+        //linear gains are equal and settled here, drive has nothing to drive
+        const float* linearRamp = getGainRamp(mBandLinearSmoothed[0], bandLinearRamp, numSamples);
+        for (auto& drive : mBandDriveSmoothed)
+            drive.setCurrentAndTargetValue(drive.getTargetValue());
+        if (!mCollapseRunning)
+            resetCollapse();
 
-                low = lowBandDistortion.processSample(low);
-                low *= band1Level;
+        for (int channel = 0; channel < totalNumInputChannels; ++channel) {
+            auto* channelData = buffer.getWritePointer(channel);
+            applyGain(channelData, inputRamp, mInputGainSmoothed.getCurrentValue(), numSamples);
+            delayDry(channel, channelData, numSamples, 0);
+            for (int sample = 0; sample < numSamples; sample++)
+                mSplitInput[sample * totalNumInputChannels + channel] = channelData[sample];
+        }
+        processCollapsed(buffer, totalNumInputChannels, numSamples, linearRamp,
+            mBandLinearSmoothed[0].getCurrentValue(), dryDelay);
 
-                if (lowMidBandDistortion.getType() != DistortionTypes::None)
-                    lowMid *= band2Drive;
+        mTreeRunning = false;
+        mCollapseRunning = true;
+    }
+    else {
+        //the split sat out a bypass, idle or collapse, so its state is stale
+        //start it clean, the crossfade brings it in from silence
+        if (!mTreeRunning)
+            resetDspState();
+        mTreeRunning = true;
+
+        bool runCollapse = collapseFading || mFullyCollapsed;
+        if (runCollapse && !mCollapseRunning)
+            resetCollapse();
+        mCollapseRunning = runCollapse;
+
+        //delayed dry copy to fade against
+        const float* bypassRamp = nullptr;
+        const float* processedRamp = nullptr;
+        if (bypassFading) {
+            auto* ramp = mRampBuffer.getWritePointer(bypassDryRamp);
+            auto* inverseRamp = mRampBuffer.getWritePointer(bypassProcessedRamp);
+            for (int i = 0; i < numSamples; i++) {
+                ramp[i] = mBypassSmoothed.getNextValue();
+                inverseRamp[i] = 1.0f - ramp[i];
+            }
+            bypassRamp = ramp;
+            processedRamp = inverseRamp;
 
-                lowMid = lowMidBandDistortion.processSample(lowMid);
-                lowMid *= band2Level;
+            for (int channel = 0; channel < totalNumInputChannels; ++channel) {
+                auto* dryData = mDryBuffer.getWritePointer(channel);
+                copyWithGain(dryData, buffer.getReadPointer(channel), inputRamp, mInputGainSmoothed.getCurrentValue(), numSamples);
+                delayDry(channel, dryData, numSamples, dryDelay);
+            }
+        }
 
-                if (highMidBandDistortion.getType() != DistortionTypes::None)
-                    highMid *= band3Drive;
+        const float* driveRamp[4];
+        const float* wetRamp[4];
+        const float* linearRamp[4];
+        for (int band = 0; band < 4; band++) {
+            driveRamp[band] = getGainRamp(mBandDriveSmoothed[band], bandDriveRamp + band, numSamples);
+            wetRamp[band] = getGainRamp(mBandWetSmoothed[band], bandWetRamp + band, numSamples);
+            linearRamp[band] = getGainRamp(mBandLinearSmoothed[band], bandLinearRamp + band, numSamples);
+        }
 
-                highMid = highMidBandDistortion.processSample(highMid);
-                highMid *= band3Level;
+        //culled filters have stale state, start them clean when the band comes back
+        //its gains ramp up from 0 so the restart is faded in
+        for (int band = 0; band < 4; band++) {
+            if (!bandActive[band])
+                mBandFiltersStale[band] = true;
+            else if (mBandFiltersStale[band]) {
+                resetBandFilters(band);
+                mBandFiltersStale[band] = false;
+            }
+        }
+        if (!monoActive)
+            mMonoLowStale = true;
+        else if (mMonoLowStale) {
+            resetMonoLow();
+            mMonoLowStale = false;
+        }
 
-                if (highBandDistortion.getType() != DistortionTypes::None)
-                    high *= band4Drive;
+        //low band gains split between the stereo and mono chains while toggling
+        const float* stereoLinearRamp = linearRamp[0];
+        const float* monoLinearRamp = linearRamp[0];
+        const float* stereoWeights = nullptr;
+        const float* monoWeights = nullptr;
+        if (monoFading) {
+            auto* weights = mRampBuffer.getWritePointer(monoWeightRamp);
+            auto* inverseWeights = mRampBuffer.getWritePointer(stereoWeightRamp);
+            for (int i = 0; i < numSamples; i++) {
+                weights[i] = mMonoBassSmoothed.getNextValue();
+                inverseWeights[i] = 1.0f - weights[i];
+            }
+            monoWeights = weights;
+            stereoWeights = inverseWeights;
+            stereoLinearRamp = getWeightedRamp(linearRamp[0], mBandLinearSmoothed[0].getCurrentValue(),
+                stereoWeights, stereoLinearWeightedRamp, numSamples);
+            monoLinearRamp = getWeightedRamp(linearRamp[0], mBandLinearSmoothed[0].getCurrentValue(),
+                monoWeights, monoLinearWeightedRamp, numSamples);
+        }
 
-                high = highBandDistortion.processSample(high);
-                high *= band4Level;
+        //what the work items need to know about this block
+        mBlockWork.buffer = &buffer;
+        mBlockWork.numChannels = totalNumInputChannels;
+        mBlockWork.numSamples = numSamples;
+        for (int band = 0; band < 4; band++) {
+            mBlockWork.bandActive[band] = bandActive[band];
+            mBlockWork.shaping[band] = shaping[band];
+        }
+        mBlockWork.monoActive = monoActive;
+        mBlockWork.monoShaping = monoShaping;
 
-                //solo, mute
-                if (mute[0] || (anySolo && !solo[0])) low = 0.0f;
-                if (mute[1] || (anySolo && !solo[1])) lowMid = 0.0f;
-                if (mute[2] || (anySolo && !solo[2])) highMid = 0.0f;
-                if (mute[3] || (anySolo && !solo[3])) high = 0.0f;
+        for (int channel = 0; channel < totalNumInputChannels; ++channel) {
+            auto* channelData = buffer.getWritePointer(channel);
+            //overall input gain - NOT DRIVE
+            applyGain(channelData, inputRamp, mInputGainSmoothed.getCurrentValue(), numSamples);
+            //keep the bypass delay primed so a later toggle lines up
+            if (!bypassFading)
+                delayDry(channel, channelData, numSamples, 0);
+        }
 
-                float wet = (low + lowMid + highMid + high);
-                samples[i] = dryMix * (1.0f - masterMix) + wet * masterMix;
+        //frames of every channel side by side for the filter banks
+        for (int channel = 0; channel < totalNumInputChannels; ++channel) {
+            auto* channelData = buffer.getReadPointer(channel);
+            for (int sample = 0; sample < numSamples; sample++)
+                mSplitInput[sample * totalNumInputChannels + channel] = channelData[sample];
+        }
 
+        //split bands at host rate
+        //each band filters all channels at once and is its own work item
+        //item 4 is the mono low band
+        //a sub-block's split is cheaper than handing it to another thread, so it always stays here
+        auto split = [this](int item) { splitBand(item); };
+        runWorkItems(5, split, false);
+
+        //collapsed filter on its way in or out, mixed in at the end
+        const float* collapseRamp = nullptr;
+        const float* treeRamp = nullptr;
+        if (runCollapse) {
+            processCollapsed(mCollapseBuffer, totalNumInputChannels, numSamples, linearRamp[0],
+                mBandLinearSmoothed[0].getCurrentValue(), dryDelay);
+
+            if (collapseFading) {
+                auto* ramp = mRampBuffer.getWritePointer(collapseFadeRamp);
+                auto* inverseRamp = mRampBuffer.getWritePointer(treeFadeRamp);
+                for (int i = 0; i < numSamples; i++) {
+                    ramp[i] = mCollapseSmoothed.getNextValue();
+                    inverseRamp[i] = 1.0f - ramp[i];
+                }
+                collapseRamp = ramp;
+                treeRamp = inverseRamp;
             }
-            oversampler.processSamplesDown(channelBlock);
         }
-        else
+
+        //linear path is written back into the buffer, driven bands stay in the band buffers
+        for (int channel = 0; channel < totalNumInputChannels; ++channel)
         {
             auto* channelData = buffer.getWritePointer(channel);
-
-            if (bypassOn)
-            {
-                for (int sample = 0; sample < buffer.getNumSamples(); sample++)
-                    channelData[sample] *= inputGain;
-                continue;
+            float* bandData[4] = {
+                mBandBuffers[0].getWritePointer(channel),
+                mBandBuffers[1].getWritePointer(channel),
+                mBandBuffers[2].getWritePointer(channel),
+                mBandBuffers[3].getWritePointer(channel)
+            };
+
+            //specifically done to avoid phase issues when using dry/wet
+            //filters inherently introduce phase shifts
+            //so we cannot use the original input signal
+            const float* bandRamp[4] = { stereoLinearRamp, linearRamp[1], linearRamp[2], linearRamp[3] };
+            bool anyActive = false;
+            for (int band = 0; band < 4; band++) {
+                if (!bandActive[band])
+                    continue;
+
+                if (anyActive)
+                    addWithGain(channelData, bandData[band], bandRamp[band], mBandLinearSmoothed[band].getCurrentValue(), numSamples);
+                else
+                    copyWithGain(channelData, bandData[band], bandRamp[band], mBandLinearSmoothed[band].getCurrentValue(), numSamples);
+                anyActive = true;
             }
+            if (monoActive) {
+                if (anyActive)
+                    addWithGain(channelData, mMonoBandBuffer.getReadPointer(0), monoLinearRamp, mBandLinearSmoothed[0].getCurrentValue(), numSamples);
+                else
+                    copyWithGain(channelData, mMonoBandBuffer.getReadPointer(0), monoLinearRamp, mBandLinearSmoothed[0].getCurrentValue(), numSamples);
+                anyActive = true;
+            }
+            if (!anyActive)
+                juce::FloatVectorOperations::clear(channelData, numSamples);
 
-            for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-
-                float input = channelData[sample] * inputGain;
-
-                float low = mLowBandLP[channel].process(input);
-                float lowMid = mLowMidBandLP[channel].process(mLowMidBandHP[channel].process(input));
-                float highMid = mHighMidBandLP[channel].process(mHighMidBandHP[channel].process(input));
-                float high = mHighBandHP[channel].process(input);
-
-                //specifically done to avoid phase issues when using dry/wet
-                float dryMix = low + lowMid + highMid + high;
-
-                if (lowBandDistortion.getType() != DistortionTypes::None)
-                    low *= band1Drive;
-
-                low = lowBandDistortion.processSample(low);
-                low *= band1Level;
-
-                if (lowMidBandDistortion.getType() != DistortionTypes::None)
-                    lowMid *= band2Drive;
-
-                lowMid = lowMidBandDistortion.processSample(lowMid);
-                lowMid *= band2Level;
-
-                if (highMidBandDistortion.getType() != DistortionTypes::None)
-                    highMid *= band3Drive;
-
-                highMid = highMidBandDistortion.processSample(highMid);
-                highMid *= band3Level;
-
-                if (highBandDistortion.getType() != DistortionTypes::None)
-					high *= band4Drive;
+            //ACTUAL DRIVE
+            for (int band = 0; band < 4; band++) {
+                if (shaping[band])
+                    applyGain(bandData[band], driveRamp[band], mBandDriveSmoothed[band].getCurrentValue(), numSamples);
+            }
+        }
+        if (monoShaping)
+            applyGain(mMonoBandBuffer.getWritePointer(0), driveRamp[0], mBandDriveSmoothed[0].getCurrentValue(), numSamples);
+
+        //auto oversampling
+        //block peak after drive against the knee of each curve and the top of each band
+        if (mAutoOversampling) {
+            int requiredFactor = 1;
+            for (int band = 0; band < 4; band++) {
+                if (!shaping[band])
+                    continue;
+                //only the channels in use, the band buffers may have more
+                float peak = 0.0f;
+                for (int channel = 0; channel < totalNumInputChannels; ++channel)
+                    peak = std::max(peak, mBandBuffers[band].getMagnitude(channel, 0, numSamples));
+                requiredFactor = std::max(requiredFactor, getRequiredOversamplingFactor(band, peak));
+            }
+            if (monoShaping)
+                requiredFactor = std::max(requiredFactor,
+                    getRequiredOversamplingFactor(0, mMonoBandBuffer.getMagnitude(0, 0, numSamples)));
+
+            //step up straight away, only step down after 100ms of needing less
+            //so a factor doesn't flap on every transient
+            if (requiredFactor >= mCurrentOversamplingFactor) {
+                mAutoHoldSamples = 0;
+                setOversamplingFactor(requiredFactor);
+            }
+            else {
+                mAutoHoldSamples += numSamples;
+                if (mAutoHoldSamples >= int(mHostSampleRate * 0.1)) {
+                    mAutoHoldSamples = 0;
+                    setOversamplingFactor(requiredFactor);
+                }
+            }
+        }
 
-                high = highBandDistortion.processSample(high);
-                high *= band4Level;
+        //shape each band on its own, oversampled if needed
+        //item 4 is the linear path, it goes through the same up/down filters as the bands
+        //so everything lines up in phase when summed
+        //item 5 is the mono low band
+        //spectrum of each shaper's input and output, only while the editor is open to look at it
+        //the low band comes from the mono buffer when that's the one being shaped
+        bool analyse = spectrumAnalyzer.isActive();
+        auto pushSpectrum = [&](bool postShaper) {
+            for (int band = 0; band < 4; band++) {
+                if (shaping[band])
+                    spectrumAnalyzer.push(band, postShaper, mBandBuffers[band].getReadPointer(0), numSamples);
+                else if (band == 0 && monoShaping)
+                    spectrumAnalyzer.push(band, postShaper, mMonoBandBuffer.getReadPointer(0), numSamples);
+            }
+        };
+        if (analyse)
+            pushSpectrum(false);
+
+        //shaping is only shared when this sub-block has enough oversampled work to pay for the handoff
+        updateBandFactors();
+        bool shareShaping = useWorkers
+            && numSamples * totalNumInputChannels * mCurrentOversamplingFactor >= minThreadedShapeSamples;
+        auto shape = [this](int item) { shapeBand(item); };
+        runWorkItems(6, shape, shareShaping);
+
+        if (analyse)
+            pushSpectrum(true);
+
+        //shaped low band outputs weighted for the mono crossfade
+        if (monoFading) {
+            if (shaping[0]) {
+                for (int channel = 0; channel < totalNumInputChannels; ++channel)
+                    juce::FloatVectorOperations::multiply(mBandBuffers[0].getWritePointer(channel), stereoWeights, numSamples);
+            }
+            if (monoShaping)
+                juce::FloatVectorOperations::multiply(mMonoBandBuffer.getWritePointer(0), monoWeights, numSamples);
+        }
 
-                //solo, mute
-                if (mute[0] || (anySolo && !solo[0])) low = 0.0f;
-                if (mute[1] || (anySolo && !solo[1])) lowMid = 0.0f;
-                if (mute[2] || (anySolo && !solo[2])) highMid = 0.0f;
-                if (mute[3] || (anySolo && !solo[3])) high = 0.0f;
+        for (int channel = 0; channel < totalNumInputChannels; ++channel) {
+            //solo, mute, level and wet mix already folded into the wet gain
+            auto* channelData = buffer.getWritePointer(channel);
+            for (int band = 0; band < 4; band++) {
+                if (shaping[band])
+                    addWithGain(channelData, mBandBuffers[band].getReadPointer(channel),
+                        wetRamp[band], mBandWetSmoothed[band].getCurrentValue(), numSamples);
+            }
+            if (monoShaping)
+                addWithGain(channelData, mMonoBandBuffer.getReadPointer(0),
+                    wetRamp[0], mBandWetSmoothed[0].getCurrentValue(), numSamples);
 
-                float wet = (low + lowMid + highMid + high);
-                channelData[sample] = dryMix * (1.0f - masterMix) + wet * masterMix;
+            if (collapseFading) {
+                juce::FloatVectorOperations::multiply(channelData, treeRamp, numSamples);
+                juce::FloatVectorOperations::addWithMultiply(channelData, mCollapseBuffer.getReadPointer(channel), collapseRamp, numSamples);
+            }
+            else if (runCollapse) {
+                juce::FloatVectorOperations::copy(channelData, mCollapseBuffer.getReadPointer(channel), numSamples);
+            }
 
+            if (bypassFading) {
+                juce::FloatVectorOperations::multiply(channelData, processedRamp, numSamples);
+                juce::FloatVectorOperations::addWithMultiply(channelData, mDryBuffer.getReadPointer(channel), bypassRamp, numSamples);
             }
         }
     }
         
-        //oscilloscope visualisation
-        auto* readPtr = buffer.getReadPointer(0);
-        for (int i = 0; i < buffer.getNumSamples(); i++)
-        {
-            oscBuffer.write(readPtr[i]);
+        //oscilloscope visualisation, dropped straight away while no editor is open
+        oscBuffer.write(buffer.getReadPointer(0), numSamples);
+
+        //tails are done once a silent input gives a silent output
+        //measured before the output gain, a turned down output would hide tails that are still ringing
+        if (!idle) {
+            float outputPeak = 0.0f;
+            for (int channel = 0; channel < totalNumInputChannels; ++channel)
+                outputPeak = std::max(outputPeak, buffer.getMagnitude(channel, 0, numSamples));
+            mTailsSilent = inputSilent && outputPeak < silenceThreshold;
         }
 
-        buffer.applyGain(outputGain);
+        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+            applyGain(buffer.getWritePointer(channel), outputRamp, mOutputGainSmoothed.getCurrentValue(), numSamples);
 
 }
 
@@ -610,20 +1171,548 @@ void MBDistortionAudioProcessor::setBandDistortionType(int bandIndex, Distortion
 
 //oversampling
 void MBDistortionAudioProcessor::updateOversamplefactor() {
-    int choice = *parameters.getRawParameterValue("oversamplingFactor");
+    int choice = *mParams.oversamplingFactor;
     //cast, getRawParameterValue returns float
     int choiceIndex = static_cast<int>(choice);
 
+    mAutoOversampling = (choiceIndex == 4);
+
     switch (choiceIndex) {
         case 0: mCurrentOversamplingFactor = 1; break; //off
         case 1: mCurrentOversamplingFactor = 2; break; //x2
         case 2: mCurrentOversamplingFactor = 4; break; //x4
         case 3: mCurrentOversamplingFactor = 8; break; //x8
+        case 4: break; //auto, picked per block in processBlock
         default: mCurrentOversamplingFactor = 1; break; //off
     }
+    mCeilingOversamplingFactor = mAutoOversampling ? 8 : mCurrentOversamplingFactor;
+}
+
+void MBDistortionAudioProcessor::layoutScratch(int numChannels) {
+    //each band's channels sit next to each other
+    for (auto& bandChannels : mBandChannels) {
+        for (auto& channelData : bandChannels)
+            channelData = mArena.take<float>(controlBlockSize);
+    }
+    for (auto& ramp : mRampChannels)
+        ramp = mArena.take<float>(controlBlockSize);
+    for (auto& channelData : mDryChannels)
+        channelData = mArena.take<float>(controlBlockSize);
+    for (auto& channelData : mCollapseChannels)
+        channelData = mArena.take<float>(controlBlockSize);
+
+    mMonoBandChannel = mArena.take<float>(controlBlockSize);
+
+    //interleaved frames for the filter banks
+    mSplitInput = mArena.take<double>(numChannels * controlBlockSize);
+    mMonoFrames = mArena.take<double>(controlBlockSize);
+    for (auto& bandFrames : mSplitBands)
+        bandFrames = mArena.take<double>(numChannels * controlBlockSize);
+}
+
+void MBDistortionAudioProcessor::processCollapsed(juce::AudioBuffer<float>& output, int numChannels, int numSamples,
+    const float* gainRamp, float gain, int delay) {
+    //in place on the interleaved input, the split is done with it by now
+    mCollapse.process(mSplitInput, mSplitInput, numSamples, numChannels);
+
+    for (int channel = 0; channel < numChannels; channel++) {
+        auto* data = output.getWritePointer(channel);
+        for (int sample = 0; sample < numSamples; sample++)
+            data[sample] = (float)mSplitInput[sample * numChannels + channel];
+        applyGain(data, gainRamp, gain, numSamples);
+        delayWithHistory(mCollapseHistory[channel], data, numSamples, delay);
+    }
+}
+
+void MBDistortionAudioProcessor::resetCollapse() {
+    mCollapse.reset();
+    for (auto& history : mCollapseHistory)
+        history.fill(0.0f);
+}
+
+void MBDistortionAudioProcessor::splitBand(int band) {
+    if (band == 4) {
+        splitMonoLow();
+        return;
+    }
+    if (!mBlockWork.bandActive[band])
+        return;
+
+    const double* input = mSplitInput;
+    double* output = mSplitBands[band];
+    int numChannels = mBlockWork.numChannels;
+    int numSamples = mBlockWork.numSamples;
+
+    //each band filtered in its own pass so culled bands cost nothing
+    switch (band) {
+    case 0:
+        mLowBandLP.process(input, output, numSamples, numChannels);
+        break;
+    case 1:
+        mLowMidBandHP.process(input, output, numSamples, numChannels);
+        mLowMidBandLP.process(output, output, numSamples, numChannels);
+        break;
+    case 2:
+        mHighMidBandHP.process(input, output, numSamples, numChannels);
+        mHighMidBandLP.process(output, output, numSamples, numChannels);
+        break;
+    default:
+        mHighBandHP.process(input, output, numSamples, numChannels);
+        break;
+    }
+
+    for (int channel = 0; channel < numChannels; channel++) {
+        auto* bandData = mBandBuffers[band].getWritePointer(channel);
+        for (int sample = 0; sample < numSamples; sample++)
+            bandData[sample] = (float)output[sample * numChannels + channel];
+    }
+}
+
+void MBDistortionAudioProcessor::splitMonoLow() {
+    if (!mBlockWork.monoActive)
+        return;
+
+    int numChannels = mBlockWork.numChannels;
+    int numSamples = mBlockWork.numSamples;
+    const double channelScale = 1.0 / numChannels;
+
+    //average of the channels, so dual mono comes out at the same level
+    for (int sample = 0; sample < numSamples; sample++) {
+        double sum = 0.0;
+        for (int channel = 0; channel < numChannels; channel++)
+            sum += mSplitInput[sample * numChannels + channel];
+        mMonoFrames[sample] = sum * channelScale;
+    }
+    mMonoLowBandLP.process(mMonoFrames, mMonoFrames, numSamples, 1);
+
+    auto* bandData = mMonoBandBuffer.getWritePointer(0);
+    for (int sample = 0; sample < numSamples; sample++)
+        bandData[sample] = (float)mMonoFrames[sample];
+}
+
+void MBDistortionAudioProcessor::resetMonoLow() {
+    mMonoLowBandLP.reset();
+    mMonoBandOversample.reset();
+    mMonoLowDistortion.reset();
+}
+
+const float* MBDistortionAudioProcessor::getWeightedRamp(const float* ramp, float gain, const float* weights, int rampIndex, int numSamples) {
+    auto* weighted = mRampBuffer.getWritePointer(rampIndex);
+    if (ramp != nullptr)
+        juce::FloatVectorOperations::multiply(weighted, ramp, weights, numSamples);
+    else
+        juce::FloatVectorOperations::multiply(weighted, weights, gain, numSamples);
+    return weighted;
+}
+
+void MBDistortionAudioProcessor::shapeBand(int item) {
+    if (item == 4) {
+        mLinearOversample.process(*mBlockWork.buffer, mBlockWork.numChannels, mBlockWork.numSamples, nullptr);
+        return;
+    }
+    if (item == 5) {
+        if (mBlockWork.monoShaping)
+            mMonoBandOversample.process(mMonoBandBuffer, 1, mBlockWork.numSamples, &mMonoLowDistortion);
+        return;
+    }
+
+    DistortionProcessor* bandDistortion[4] = { &lowBandDistortion, &lowMidBandDistortion,
+        &highMidBandDistortion, &highBandDistortion };
+    if (mBlockWork.shaping[item])
+        mBandOversample[item].process(mBandBuffers[item], mBlockWork.numChannels, mBlockWork.numSamples, bandDistortion[item]);
+}
+
+void MBDistortionAudioProcessor::setOversamplingFactor(int factor) {
+    //governor caps whatever was asked for
+    mCurrentOversamplingFactor = std::min(factor, mGovernorMaxFactor);
+    factor = mCurrentOversamplingFactor;
+
+    //the bands follow in updateBandFactors once the crossovers and curves are known
+    //lower factors than the ceiling are delayed up to its latency
+    mLinearOversample.setFactor(factor);
+    mLinearOversample.setAlignment(mLinearOversample.getFactorLatency(mCeilingOversamplingFactor));
+    updateReportedLatency();
+}
+
+void MBDistortionAudioProcessor::updateBandFactors() {
+    bool multirate = *mParams.multirate > 0.5f;
+    int alignLatency = mLinearOversample.getFactorLatency(mCeilingOversamplingFactor);
+
+    for (int band = 0; band < 4; band++) {
+        //worst case drive, so the factor only moves with the crossovers, the curve or the global factor
+        int factor = mCurrentOversamplingFactor;
+        if (multirate)
+            factor = std::min(factor, getRequiredOversamplingFactor(band, std::numeric_limits<float>::max()));
+
+        mBandOversample[band].setFactor(factor);
+        mBandOversample[band].setAlignment(alignLatency);
+        if (band == 0) {
+            mMonoBandOversample.setFactor(factor);
+            mMonoBandOversample.setAlignment(alignLatency);
+        }
+    }
+}
+
+//lowest factor where the harmonics of this band fold back above the audible range
+int MBDistortionAudioProcessor::getRequiredOversamplingFactor(int bandIndex, float peak) const {
+    DistortionTypes type = DistortionTypes::None;
+    double bandTop = mHostSampleRate / 2.0;
+
+    switch (bandIndex) {
+    case 0: type = lowBandDistortion.getType(); bandTop = lastCrossoverFreq1; break;
+    case 1: type = lowMidBandDistortion.getType(); bandTop = lastCrossoverFreq2; break;
+    case 2: type = highMidBandDistortion.getType(); bandTop = lastCrossoverFreq3; break;
+    case 3: type = highBandDistortion.getType(); break;
+    default: break;
+    }
+
+    double highestHarmonic = bandTop * DistortionProcessor::getHarmonicReach(type, peak);
+    double audibleLimit = std::min(20000.0, mHostSampleRate / 2.0);
+
+    //harmonic h at rate fs * factor aliases down to (fs * factor - h)
+    for (int factor = 1; factor < 8; factor *= 2) {
+        if (highestHarmonic <= factor * mHostSampleRate - audibleLimit)
+            return factor;
+    }
+    return 8;
 }
 
 const double MBDistortionAudioProcessor::getEffectiveSampleRate()
 {
     return mHostSampleRate * mCurrentOversamplingFactor;
-}
\ No newline at end of file
+}
+//cpu governor
+//compares block time against the block deadline and moves the factor cap with hysteresis
+void MBDistortionAudioProcessor::updateGovernor(double blockSeconds, int numSamples) {
+    int previousMaxFactor = mGovernorMaxFactor;
+    bool governorOn = (*mParams.cpuGovernor > 0.5f);
+    if (!governorOn || numSamples <= 0) {
+        mGovernorMaxFactor = 8;
+        mGovernorLoad = 0.0;
+        mGovernorHoldSamples = 0;
+    }
+    else {
+        float budget = *mParams.cpuBudget / 100.0f;
+        double deadline = numSamples / mHostSampleRate;
+
+        //smoothed so one late block doesn't throw the factor away
+        mGovernorLoad = 0.8 * mGovernorLoad + 0.2 * (blockSeconds / deadline);
+        mGovernorHoldSamples += numSamples;
+
+        //step down after 50ms over budget
+        if (mGovernorLoad > budget && mGovernorMaxFactor > 1) {
+            if (mGovernorHoldSamples >= int(mHostSampleRate * 0.05)) {
+                mGovernorMaxFactor = std::max(1, std::min(mGovernorMaxFactor, mCurrentOversamplingFactor) / 2);
+                //roughly half the work now, start the estimate again from there
+                mGovernorLoad *= 0.5;
+                mGovernorHoldSamples = 0;
+            }
+        }
+        //step back up only after 1s with enough headroom for twice the work
+        else if (mGovernorLoad < budget * 0.4f && mGovernorMaxFactor < 8) {
+            if (mGovernorHoldSamples >= int(mHostSampleRate)) {
+                mGovernorMaxFactor *= 2;
+                mGovernorHoldSamples = 0;
+            }
+        }
+        else {
+            mGovernorHoldSamples = 0;
+        }
+    }
+
+    //a new cap applies now, not whenever the factor is next asked for
+    //fixed factors go back to the choice, auto keeps its pick and raises it again when it needs to
+    if (mGovernorMaxFactor != previousMaxFactor) {
+        if (!mAutoOversampling)
+            updateOversamplefactor();
+        setOversamplingFactor(mCurrentOversamplingFactor);
+        updateBandFactors();
+    }
+}
+
+//parameters
+//derived values only get recomputed when a listener has flagged their inputs
+void MBDistortionAudioProcessor::updateDerivedParameters() {
+    if (mGainsDirty.consume()) {
+        for (int band = 0; band < 4; band++) {
+            mDerived.bandDrive[band] = std::pow(10.0f, *mParams.bandDrive[band] / 20.0f);
+            mDerived.bandLevel[band] = std::pow(10.0f, *mParams.bandLevel[band] / 20.0f);
+            mDerived.solo[band] = *mParams.bandSolo[band] > 0.5f;
+            mDerived.mute[band] = *mParams.bandMute[band] > 0.5f;
+        }
+        mDerived.anySolo = mDerived.solo[0] || mDerived.solo[1] || mDerived.solo[2] || mDerived.solo[3];
+
+        //inputgain, outputgain, masterMix
+        mDerived.inputGain = std::pow(10.0f, *mParams.inputGain / 20.0f);
+        mDerived.outputGain = std::pow(10.0f, *mParams.outputGain / 20.0f);
+        mDerived.masterMix = *mParams.masterMix;
+    }
+
+    //setDistortionType resets the shaper, so only on an actual change
+    //None is left to finishTypeChanges, the old curve has to keep clipping while the band fades out
+    if (mTypesDirty.consume()) {
+        DistortionProcessor* bandDistortion[4] = { &lowBandDistortion, &lowMidBandDistortion,
+            &highMidBandDistortion, &highBandDistortion };
+
+        for (int band = 0; band < 4; band++) {
+            auto type = static_cast<DistortionTypes>(int(*mParams.bandType[band]));
+            mDerived.bandType[band] = type;
+            if (type != DistortionTypes::None && type != bandDistortion[band]->getType())
+                bandDistortion[band]->setDistortionType(type);
+        }
+        //mono bass shaper follows the low band
+        if (mMonoLowDistortion.getType() != lowBandDistortion.getType())
+            mMonoLowDistortion.setDistortionType(lowBandDistortion.getType());
+    }
+}
+
+void MBDistortionAudioProcessor::finishTypeChanges() {
+    DistortionProcessor* bandDistortion[4] = { &lowBandDistortion, &lowMidBandDistortion,
+        &highMidBandDistortion, &highBandDistortion };
+
+    for (int band = 0; band < 4; band++) {
+        if (mDerived.bandType[band] == DistortionTypes::None
+            && bandDistortion[band]->getType() != DistortionTypes::None
+            && !mBandWetSmoothed[band].isSmoothing())
+            bandDistortion[band]->setDistortionType(DistortionTypes::None);
+    }
+    if (mMonoLowDistortion.getType() != lowBandDistortion.getType())
+        mMonoLowDistortion.setDistortionType(lowBandDistortion.getType());
+}
+
+void MBDistortionAudioProcessor::updateCrossovers() {
+    takeCollapseDesign();
+    if (!mCrossoverDirty.consume())
+        return;
+
+    float targetFreq1 = *mParams.crossoverFreq[0];
+    float targetFreq2 = *mParams.crossoverFreq[1];
+    float targetFreq3 = *mParams.crossoverFreq[2];
+
+    //crossover runs at host rate
+    //enforce order & nyquist
+    targetFreq1 = std::clamp(targetFreq1, 20.0f, (float)(mHostSampleRate / 2.0 * 0.95));
+    targetFreq2 = std::clamp(targetFreq2, targetFreq1 + minCrossoverFreq, (float)(mHostSampleRate / 2.0 * 0.95));
+    targetFreq3 = std::clamp(targetFreq3, targetFreq2 + minCrossoverFreq, (float)(mHostSampleRate / 2.0 * 0.95));
+
+    if (targetFreq1 != lastCrossoverFreq1 || targetFreq2 != lastCrossoverFreq2 || targetFreq3 != lastCrossoverFreq3) {
+        mLowBandLP.setCutoff(targetFreq1);
+        mMonoLowBandLP.setCutoff(targetFreq1);
+        mLowMidBandHP.setCutoff(targetFreq1);
+
+        mLowMidBandLP.setCutoff(targetFreq2);
+        mHighMidBandHP.setCutoff(targetFreq2);
+
+        mHighMidBandLP.setCutoff(targetFreq3);
+        mHighBandHP.setCutoff(targetFreq3);
+
+        lastCrossoverFreq1 = targetFreq1;
+        lastCrossoverFreq2 = targetFreq2;
+        lastCrossoverFreq3 = targetFreq3;
+        requestCollapseDesign();
+    }
+}
+
+void MBDistortionAudioProcessor::requestCollapseDesign() {
+    //offline nothing is waiting on the audio, so the bounce gets the new design on the very next sample
+    if (isNonRealtime()) {
+        auto design = CollapsedCrossover::design(mHostSampleRate, lastCrossoverFreq1, lastCrossoverFreq2, lastCrossoverFreq3);
+        mCollapse.setDesign(design);
+        mCollapseValid = design.valid;
+        return;
+    }
+
+    mCollapseRequest[0].store(mHostSampleRate, std::memory_order_relaxed);
+    mCollapseRequest[1].store(lastCrossoverFreq1, std::memory_order_relaxed);
+    mCollapseRequest[2].store(lastCrossoverFreq2, std::memory_order_relaxed);
+    mCollapseRequest[3].store(lastCrossoverFreq3, std::memory_order_relaxed);
+    mCollapseRequested.store(true, std::memory_order_release);
+}
+
+//message thread
+void MBDistortionAudioProcessor::designCollapse() {
+    mCollapseDesigns[mCollapseDesignBack] = CollapsedCrossover::design(
+        mCollapseRequest[0].load(std::memory_order_relaxed), mCollapseRequest[1].load(std::memory_order_relaxed),
+        mCollapseRequest[2].load(std::memory_order_relaxed), mCollapseRequest[3].load(std::memory_order_relaxed));
+    mCollapseDesignBack = mCollapseDesignMiddle.exchange(mCollapseDesignBack | 4, std::memory_order_acq_rel) & 3;
+}
+
+//audio thread, only swaps in a finished design
+void MBDistortionAudioProcessor::takeCollapseDesign() {
+    if ((mCollapseDesignMiddle.load(std::memory_order_relaxed) & 4) == 0)
+        return;
+    mCollapseDesignFront = mCollapseDesignMiddle.exchange(mCollapseDesignFront, std::memory_order_acq_rel) & 3;
+
+    //a design for crossovers that have moved on since is dropped, the newer request is already out
+    const auto& design = mCollapseDesigns[mCollapseDesignFront];
+    if (design.sampleRate != mHostSampleRate || design.freqs[0] != lastCrossoverFreq1
+        || design.freqs[1] != lastCrossoverFreq2 || design.freqs[2] != lastCrossoverFreq3)
+        return;
+
+    mCollapse.setDesign(design);
+    mCollapseValid = design.valid;
+}
+
+//gain ramps
+//per band gains fold level, mute/solo and mix together
+void MBDistortionAudioProcessor::setGainTargets() {
+    for (int band = 0; band < 4; band++) {
+        bool typeShaping = mDerived.bandType[band] != DistortionTypes::None;
+        float gate = (mDerived.mute[band] || (mDerived.anySolo && !mDerived.solo[band])) ? 0.0f : 1.0f;
+        float wetGain = mDerived.masterMix * mDerived.bandLevel[band] * gate;
+
+        //drive only when there is something to drive
+        mBandDriveSmoothed[band].setTargetValue(typeShaping ? mDerived.bandDrive[band] : 1.0f);
+        mBandWetSmoothed[band].setTargetValue(typeShaping ? wetGain : 0.0f);
+        mBandLinearSmoothed[band].setTargetValue((1.0f - mDerived.masterMix) + (typeShaping ? 0.0f : wetGain));
+    }
+
+    mInputGainSmoothed.setTargetValue(mDerived.inputGain);
+    mOutputGainSmoothed.setTargetValue(mDerived.outputGain);
+}
+
+//fills this block's ramp into the scratch buffer, nullptr if the value isn't moving
+//the smoothers are linear, so the ramp is a straight line up to the target and the target after that
+const float* MBDistortionAudioProcessor::getGainRamp(juce::SmoothedValue<float>& value, int rampIndex, int numSamples) {
+    if (!value.isSmoothing() || numSamples <= 0)
+        return nullptr;
+
+    auto* ramp = mRampBuffer.getWritePointer(rampIndex);
+    const float start = value.getCurrentValue();
+    const float target = value.getTargetValue();
+    const float step = value.getNextValue() - start;
+    value.skip(numSamples - 1);
+    bool settled = !value.isSmoothing();
+
+    //when it lands inside the block, the line stops on the sample that reaches the target
+    int rampLength = numSamples;
+    if (settled && step != 0.0f)
+        rampLength = juce::jlimit(1, numSamples, juce::roundToInt((target - start) / step));
+
+    for (int i = 0; i < rampLength; i++)
+        ramp[i] = start + step * (float)(i + 1);
+
+    if (settled) {
+        ramp[rampLength - 1] = target;
+        juce::FloatVectorOperations::fill(ramp + rampLength, target, numSamples - rampLength);
+    }
+    return ramp;
+}
+
+void MBDistortionAudioProcessor::applyGain(float* data, const float* ramp, float gain, int numSamples) {
+    if (ramp != nullptr)
+        juce::FloatVectorOperations::multiply(data, ramp, numSamples);
+    else if (gain != 1.0f)
+        juce::FloatVectorOperations::multiply(data, gain, numSamples);
+}
+
+void MBDistortionAudioProcessor::copyWithGain(float* dest, const float* source, const float* ramp, float gain, int numSamples) {
+    if (ramp != nullptr)
+        juce::FloatVectorOperations::multiply(dest, source, ramp, numSamples);
+    else
+        juce::FloatVectorOperations::copyWithMultiply(dest, source, gain, numSamples);
+}
+
+void MBDistortionAudioProcessor::addWithGain(float* dest, const float* source, const float* ramp, float gain, int numSamples) {
+    if (ramp != nullptr)
+        juce::FloatVectorOperations::addWithMultiply(dest, source, ramp, numSamples);
+    else if (gain != 0.0f)
+        juce::FloatVectorOperations::addWithMultiply(dest, source, gain, numSamples);
+}
+
+void MBDistortionAudioProcessor::resetBandFilters(int bandIndex) {
+    switch (bandIndex) {
+    case 0: mLowBandLP.reset(); break;
+    case 1: mLowMidBandHP.reset(); mLowMidBandLP.reset(); break;
+    case 2: mHighMidBandHP.reset(); mHighMidBandLP.reset(); break;
+    case 3: mHighBandHP.reset(); break;
+    default: break;
+    }
+}
+
+//silence detection
+void MBDistortionAudioProcessor::snapGainSmoothers() {
+    mInputGainSmoothed.setCurrentAndTargetValue(mInputGainSmoothed.getTargetValue());
+    mOutputGainSmoothed.setCurrentAndTargetValue(mOutputGainSmoothed.getTargetValue());
+    for (int band = 0; band < 4; band++) {
+        mBandDriveSmoothed[band].setCurrentAndTargetValue(mBandDriveSmoothed[band].getTargetValue());
+        mBandWetSmoothed[band].setCurrentAndTargetValue(mBandWetSmoothed[band].getTargetValue());
+        mBandLinearSmoothed[band].setCurrentAndTargetValue(mBandLinearSmoothed[band].getTargetValue());
+    }
+}
+
+//clears every filter, oversampler and dc blocker
+void MBDistortionAudioProcessor::resetDspState() {
+    for (int band = 0; band < 4; band++) {
+        resetBandFilters(band);
+        mBandFiltersStale[band] = false;
+        mBandOversample[band].reset();
+    }
+    mLinearOversample.reset();
+    resetMonoLow();
+    mMonoLowStale = false;
+
+    lowBandDistortion.reset();
+    lowMidBandDistortion.reset();
+    highMidBandDistortion.reset();
+    highBandDistortion.reset();
+}
+
+bool MBDistortionAudioProcessor::channelsIdentical(const juce::AudioBuffer<float>& buffer) {
+    if (buffer.getNumChannels() < 2)
+        return false;
+    size_t numBytes = sizeof(float) * (size_t)buffer.getNumSamples();
+    for (int channel = 1; channel < buffer.getNumChannels(); ++channel) {
+        if (std::memcmp(buffer.getReadPointer(0), buffer.getReadPointer(channel), numBytes) != 0)
+            return false;
+    }
+    return true;
+}
+
+void MBDistortionAudioProcessor::syncChannelStates() {
+    for (auto* filter : { &mLowBandLP, &mLowMidBandHP, &mLowMidBandLP, &mHighMidBandHP, &mHighMidBandLP, &mHighBandHP })
+        filter->syncToFirstChannel();
+    mCollapse.syncToFirstChannel();
+    for (auto& bandOversample : mBandOversample)
+        bandOversample.syncToFirstChannel();
+    mLinearOversample.syncToFirstChannel();
+    for (auto* shaper : { &lowBandDistortion, &lowMidBandDistortion, &highMidBandDistortion, &highBandDistortion })
+        shaper->syncToFirstChannel();
+    for (auto* histories : { &mDryHistory, &mCollapseHistory }) {
+        for (auto& history : *histories)
+            history = histories->front();
+    }
+}
+
+//bypass
+//delays data in place by 'delay' samples using the channel's history
+//delay 0 only records the history
+void MBDistortionAudioProcessor::delayDry(int channel, float* data, int numSamples, int delay) {
+    if (channel < (int)mDryHistory.size())
+        delayWithHistory(mDryHistory[channel], data, numSamples, delay);
+}
+
+void MBDistortionAudioProcessor::delayWithHistory(std::array<float, maxDryDelay>& history, float* data, int numSamples, int delay) {
+    const int historySize = (int)history.size();
+    delay = std::min(delay, historySize);
+
+    //history followed by data, the newest historySize samples become the new history
+    std::array<float, maxDryDelay> newHistory;
+    for (int i = 0; i < historySize; i++) {
+        int index = numSamples + i;
+        newHistory[i] = index < historySize ? history[index] : data[index - historySize];
+    }
+
+    //backwards so nothing is overwritten before it's read
+    if (delay > 0) {
+        for (int i = numSamples - 1; i >= 0; i--)
+            data[i] = i >= delay ? data[i - delay] : history[historySize + i - delay];
+    }
+
+    history = newHistory;
+}
+
+juce::AudioProcessorParameter* MBDistortionAudioProcessor::getBypassParameter() const
+{
+    return parameters.getParameter("bypass");
+}
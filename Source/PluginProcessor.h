@@ -11,27 +11,83 @@
 #include <JuceHeader.h>
 #include "FilterClasses.h"
 #include "DistortionProcessor.h"
+#include "BandOversampler.h"
+#include "BandWorkerPool.h"
+#include "ScratchArena.h"
+#include "TruePeakLimiter.h"
+#include "ScopeFifo.h"
+#include "SpectrumAnalyzer.h"
+
+//host samples per control-rate sub-block, can be overridden in the preprocessor definitions
+//64 is within 1% of the fastest size at 2x/4x/8x (see SubBlockBenchmark in ProcessorBenchmark.cpp)
+//and keeps automation steps at about 1.3ms at 48k
+#ifndef MBDISTORTION_CONTROL_BLOCK_SIZE
+ #define MBDISTORTION_CONTROL_BLOCK_SIZE 64
+#endif
+
+//smallest host block the worker threads are used on, offline renders included, can be overridden in the preprocessor definitions
+//not measured yet: run ProcessorBenchmark on a multi-core machine with this set to 32 and put the crossover it logs here
+//until then threading stays off below a size where one handoff per sub-block is small next to the block
+#ifndef MBDISTORTION_MIN_THREADED_BLOCK_SIZE
+ #define MBDISTORTION_MIN_THREADED_BLOCK_SIZE 1024
+#endif
 
 //==============================================================================
 /**
 */
 
-//lecture 12 ring buffer
-class RingBuffer
+//set by the APVTS when any of its parameters change, cleared by the audio thread
+struct ParameterDirtyFlag : public juce::AudioProcessorValueTreeState::Listener
 {
-public:
-    void resize(int newSize) { mBuffer.assign(newSize, 0.0f); }
-    bool hasNewData() const { return mReadPos != mWritePos; }
-    void write(float v) { mBuffer[mWritePos] = v; mWritePos = (mWritePos + 1) % size(); }
-    float read() { auto v = mBuffer[mReadPos]; mReadPos = (mReadPos + 1) % size(); return v; }
-    int size() const { return (int)mBuffer.size(); }
+    void parameterChanged(const juce::String&, float) override { dirty.store(true, std::memory_order_release); }
+    //true once per change
+    bool consume() { return dirty.exchange(false, std::memory_order_acq_rel); }
+    void markDirty() { dirty.store(true, std::memory_order_release); }
 
-private:
-    std::atomic<int> mReadPos{ 0 }, mWritePos{ 0 };
-    std::vector<float> mBuffer;
+    std::atomic<bool> dirty{ true };
+};
+
+//raw parameter values, resolved once so the audio thread never looks up by string
+struct ParameterSnapshot
+{
+    std::atomic<float>* bandDrive[4];
+    std::atomic<float>* bandLevel[4];
+    std::atomic<float>* bandType[4];
+    std::atomic<float>* bandSolo[4];
+    std::atomic<float>* bandMute[4];
+    std::atomic<float>* crossoverFreq[3];
+    std::atomic<float>* inputGain;
+    std::atomic<float>* outputGain;
+    std::atomic<float>* masterMix;
+    std::atomic<float>* bypass;
+    std::atomic<float>* oversamplingFactor;
+    std::atomic<float>* cpuGovernor;
+    std::atomic<float>* cpuBudget;
+    std::atomic<float>* multiThreading;
+    std::atomic<float>* monoBass;
+    std::atomic<float>* multirate;
+    std::atomic<float>* internalBlockSize;
+    std::atomic<float>* truePeakLimiter;
+    std::atomic<float>* limiterCeiling;
+};
+
+//values worked out from the snapshot, only recomputed when their inputs change
+struct DerivedParameters
+{
+    //what the type parameters ask for, the shapers follow (see finishTypeChanges)
+    DistortionTypes bandType[4] = { DistortionTypes::None, DistortionTypes::None, DistortionTypes::None, DistortionTypes::None };
+    float bandDrive[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float bandLevel[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    bool solo[4] = {};
+    bool mute[4] = {};
+    bool anySolo = false;
+    float inputGain = 1.0f;
+    float outputGain = 1.0f;
+    float masterMix = 1.0f;
 };
 
-class MBDistortionAudioProcessor  : public juce::AudioProcessor
+class MBDistortionAudioProcessor  : public juce::AudioProcessor,
+    private juce::Timer
 {
 public:
     //==============================================================================
@@ -47,6 +103,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    //lets hosts drive our bypass instead of using their own
+    juce::AudioProcessorParameter* getBypassParameter() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -75,6 +133,10 @@ public:
     void setBandDistortionType(int bandIndex, DistortionTypes type);
     void updateOversamplefactor();
     const double getEffectiveSampleRate();
+    //sub-blocks skipped by the idle fast path, for profiling
+    juce::int64 getNumSkippedBlocks() const { return mNumSkippedBlocks.load(std::memory_order_relaxed); }
+    //factor actually running after auto and the cpu governor, safe to read from the editor
+    int getEffectiveOversamplingFactor() const { return mEffectiveOversamplingFactor.load(std::memory_order_relaxed); }
 
     //==============================================================================
     
@@ -83,24 +145,181 @@ public:
     juce::AudioProcessorValueTreeState parameters{ *this, nullptr, "Parameters", createParameterLayout() };
 
     //osc ringbuffer
-    RingBuffer oscBuffer;
+    ScopeFifo oscBuffer;
+    //per band spectrum, the editor switches it on while it's open
+    SpectrumAnalyzer spectrumAnalyzer;
 
 private:
     //==============================================================================
+
+    //message thread work asked for by the audio thread
+    //the audio thread only sets atomics, posting a message could block it, so they're polled here
+    static constexpr int serviceIntervalMs = 20;
+    void timerCallback() override;
     
     //define filters for bands
     //4 bands needs 6 filters
     //1 for lowband, 2 for 1st band, 2 for 2nd band, 1 for highband
+    //each filter covers every channel of the bus
     //low band
-    std::vector<LinkwitzRileyLowPass> mLowBandLP;
+    LinkwitzRileyBank mLowBandLP;
     //lowmid band
-    std::vector<LinkwitzRileyHighPass> mLowMidBandHP;
-    std::vector<LinkwitzRileyLowPass> mLowMidBandLP;
+    LinkwitzRileyBank mLowMidBandHP;
+    LinkwitzRileyBank mLowMidBandLP;
     //highmid band
-    std::vector<LinkwitzRileyHighPass> mHighMidBandHP;
-    std::vector<LinkwitzRileyLowPass> mHighMidBandLP;
+    LinkwitzRileyBank mHighMidBandHP;
+    LinkwitzRileyBank mHighMidBandLP;
     //high band
-    std::vector<LinkwitzRileyHighPass> mHighBandHP;
+    LinkwitzRileyBank mHighBandHP;
+
+    //interleaved input and band outputs for the filter banks
+    double* mSplitInput = nullptr;
+    double* mSplitBands[4] = {};
+
+    //sample-accurate automation and cache tiling
+    //the host block is processed in control-rate sub-blocks, each one a full batch
+    //at 8x on 7.1.4 a sub-block's oversampled data is 24KB, so every stage stays in L1/L2
+    //every buffer is sized for one sub-block, so blocks bigger than announced are safe too
+    static constexpr int controlBlockSize = MBDISTORTION_CONTROL_BLOCK_SIZE;
+    void processSubBlock(juce::AudioBuffer<float>& buffer, bool useWorkers);
+    //everything processBlock does once the block size is settled
+    void processInternalBlock(juce::AudioBuffer<float>& buffer);
+
+    //internal block fifo
+    //tiny or irregular host buffers are gathered into fixed blocks, at the cost of one block of latency
+    //the fifo holds the input still to be processed and, in the same slots, the output still to be sent
+    static constexpr int maxFifoBlockSize = 128;
+    juce::AudioBuffer<float> mFifoBuffer;
+    int mFifoBlockSize = 0; //0 = process at the host block size
+    int mFifoPosition = 0;
+    int getRequestedFifoBlockSize() const;
+
+    //reported latency, the audio thread works it out and the message thread tells the host
+    std::atomic<int> mPendingLatency{ 0 };
+    int getTotalLatency() const;
+    void updateReportedLatency();
+
+    //true peak limiter, last thing on the output
+    //switching it on or off changes the reported latency
+    TruePeakLimiter mLimiter;
+    bool mLimiterOn = false;
+
+    //parameters
+    ParameterSnapshot mParams;
+    DerivedParameters mDerived;
+    ParameterDirtyFlag mGainsDirty, mTypesDirty, mCrossoverDirty;
+    void updateDerivedParameters();
+    void updateCrossovers();
+    //a band switched to None keeps its curve until its wet gain has faded out
+    //switching straight away would fade out the driven signal unclipped
+    void finishTypeChanges();
+
+    //gain smoothing
+    //ramps are filled once per block into mRampBuffer and skipped when a gain is static
+    static constexpr double gainRampSeconds = 0.02;
+    enum RampIndex { inputGainRamp, outputGainRamp, bypassDryRamp, bypassProcessedRamp,
+        collapseFadeRamp, treeFadeRamp, monoWeightRamp, stereoWeightRamp,
+        monoLinearWeightedRamp, stereoLinearWeightedRamp, bandDriveRamp,
+        bandWetRamp = bandDriveRamp + 4, bandLinearRamp = bandWetRamp + 4, numRamps = bandLinearRamp + 4 };
+    juce::SmoothedValue<float> mInputGainSmoothed, mOutputGainSmoothed;
+    juce::SmoothedValue<float> mBandDriveSmoothed[4];
+    //level, mute/solo and mix folded together per band
+    juce::SmoothedValue<float> mBandWetSmoothed[4];
+    juce::SmoothedValue<float> mBandLinearSmoothed[4];
+    juce::AudioBuffer<float> mRampBuffer;
+    std::array<float*, numRamps> mRampChannels = {};
+
+    void setGainTargets();
+    const float* getGainRamp(juce::SmoothedValue<float>& value, int rampIndex, int numSamples);
+    static void applyGain(float* data, const float* ramp, float gain, int numSamples);
+    static void copyWithGain(float* dest, const float* source, const float* ramp, float gain, int numSamples);
+    static void addWithGain(float* dest, const float* source, const float* ramp, float gain, int numSamples);
+    //ramp (or gain when it's nullptr) times weights, written into the ramp buffer
+    const float* getWeightedRamp(const float* ramp, float gain, const float* weights, int rampIndex, int numSamples);
+
+    //bypass
+    //dry path is delayed by the oversampling latency so the crossfade doesn't comb
+    static constexpr double bypassRampSeconds = 0.01;
+    static constexpr int maxDryDelay = 16;
+    juce::SmoothedValue<float> mBypassSmoothed;
+    juce::AudioBuffer<float> mDryBuffer;
+    std::vector<float*> mDryChannels;
+    std::vector<std::array<float, maxDryDelay>> mDryHistory;
+    void delayDry(int channel, float* data, int numSamples, int delay);
+    static void delayWithHistory(std::array<float, maxDryDelay>& history, float* data, int numSamples, int delay);
+
+    //neutral collapse
+    //with every band linear at the same gain the split is replaced by one equivalent filter
+    //no shaping and no oversampling, entering and leaving are crossfaded
+    static constexpr double collapseRampSeconds = 0.01;
+    CollapsedCrossover mCollapse;
+    bool mCollapseValid = false;
+    //the design allocates and iterates, so the audio thread asks the message thread for it
+    //and the last design keeps running until the one for the current crossovers comes back
+    std::atomic<double> mCollapseRequest[4] = {};  //sample rate, then the 3 crossovers
+    std::atomic<bool> mCollapseRequested{ false };
+    //triple buffer, the message thread owns 'back', the audio thread owns 'front'
+    //'middle' holds the index of the third design, bit 2 set when it's newer than the audio thread's
+    CollapsedCrossover::Design mCollapseDesigns[3];
+    int mCollapseDesignBack = 0;
+    std::atomic<int> mCollapseDesignMiddle{ 1 };
+    int mCollapseDesignFront = 2;
+    void requestCollapseDesign();
+    void designCollapse();
+    void takeCollapseDesign();
+    bool mFullyCollapsed = false;
+    juce::SmoothedValue<float> mCollapseSmoothed;
+    juce::AudioBuffer<float> mCollapseBuffer;
+    std::vector<float*> mCollapseChannels;
+    std::vector<std::array<float, maxDryDelay>> mCollapseHistory;
+    void processCollapsed(juce::AudioBuffer<float>& output, int numChannels, int numSamples,
+        const float* gainRamp, float gain, int delay);
+    void resetCollapse();
+
+    //mono bass
+    //low band of the channel average, filtered, driven and shaped once
+    static constexpr double monoBassRampSeconds = 0.02;
+    juce::SmoothedValue<float> mMonoBassSmoothed;
+    LinkwitzRileyBank mMonoLowBandLP;
+    DistortionProcessor mMonoLowDistortion;
+    BandOversampler mMonoBandOversample;
+    juce::AudioBuffer<float> mMonoBandBuffer;
+    float* mMonoBandChannel = nullptr;
+    double* mMonoFrames = nullptr;
+    bool mMonoLowStale = true;
+    void splitMonoLow();
+    void resetMonoLow();
+
+    //which paths ran last sub-block, a path that sat out starts clean
+    bool mTreeRunning = true;
+    bool mCollapseRunning = false;
+
+    //silence detection
+    //-120dB, below this input and output (before the output gain) count as silent
+    static constexpr float silenceThreshold = 1.0e-6f;
+    bool mTailsSilent = false;
+    bool mIdle = false;
+    std::atomic<juce::int64> mNumSkippedBlocks{ 0 };
+    void snapGainSmoothers();
+    void resetDspState();
+
+    //dual mono
+    //identical channels run through the engine once and the result is copied out
+    //only while every channel's state is known to match, i.e. since a reset or an idle block
+    //or once the channels have been fed the same input long enough for their states to meet
+    //0.2s is over 17 time constants of the slowest state (a 20Hz crossover), more than 140dB down
+    static constexpr double channelSettleSeconds = 0.2;
+    int mChannelSettleSamples = 0;
+    int mIdenticalSamples = 0;
+    bool mChannelsInSync = true;
+    bool mDualMono = false;
+    static bool channelsIdentical(const juce::AudioBuffer<float>& buffer);
+    //the other channels sat out, they take over the first channel's state
+    void syncChannelStates();
+
+    //band culling, filters of silenced bands are skipped and restarted clean
+    bool mBandFiltersStale[4] = {};
+    void resetBandFilters(int bandIndex);
 
     //crossover freq
     //and prev crossover freq
@@ -121,11 +340,85 @@ private:
     DistortionProcessor highMidBandDistortion;
     DistortionProcessor highBandDistortion;
 
-    //oversampling (to avoid aliasing) global oversample
-    std::vector<std::unique_ptr<juce::dsp::Oversampling<float>>> mOversample;
+    //band buffers, split at host rate
+    juce::AudioBuffer<float> mBandBuffers[4];
+    std::vector<float*> mBandChannels[4];
+
+    //scratch
+    //every intermediate buffer above lives in here, sized once in prepareToPlay
+    //so the audio thread never allocates and each buffer is cache line aligned
+    ScratchArena mArena;
+    void layoutScratch(int numChannels);
+
+    //oversampling (to avoid aliasing) only around the shapers
+    BandOversampler mBandOversample[4];
+    //linear path is oversampled too so it stays in phase with the bands
+    BandOversampler mLinearOversample;
     double mHostSampleRate = 44100;
     int mCurrentOversamplingFactor = 1; //1 = "Off"
+    //highest factor auto or the governor can switch to, the chosen one or 8 for auto
+    //every path is delayed to its latency, so automatic steps don't move the latency
+    //and only a new choice is reported to the host
+    int mCeilingOversamplingFactor = 1;
     bool mOversamplingUpdate = true;
+
+    //auto oversampling
+    //lowest factor that keeps the aliasing inaudible, picked per block
+    bool mAutoOversampling = false;
+    int mAutoHoldSamples = 0;
+    int getRequiredOversamplingFactor(int bandIndex, float peak) const;
+    void setOversamplingFactor(int factor);
+
+    //multirate
+    //bands that can't alias into the audible range even fully driven run at a lower factor
+    //delayed to line up with the linear path, so only the cost changes
+    void updateBandFactors();
+
+    //cpu governor
+    //caps the factor when blocks take too long against their deadline
+    int mGovernorMaxFactor = 8;
+    double mGovernorLoad = 0.0;
+    int mGovernorHoldSamples = 0;
+    void updateGovernor(double blockSeconds, int numSamples);
+    std::atomic<int> mEffectiveOversamplingFactor{ 1 };
+
+    //multi-threading
+    //only allowed on big host blocks, then each sub-block only shares its shaping
+    //and only when there is enough oversampled work in it to be worth one handoff
+    //split and shaping run as independent items, the same code either way
+    //so the threaded output is bit-identical to the serial one
+    static constexpr int minThreadedBlockSize = MBDISTORTION_MIN_THREADED_BLOCK_SIZE;
+    //oversampled samples over all channels of one sub-block, 4x stereo
+    static constexpr int minThreadedShapeSamples = 512;
+    static constexpr int maxWorkers = 3;
+    BandWorkerPool mWorkerPool;
+    //the pool only has threads while the option is on, they're started and stopped on the message thread
+    //the audio thread never waits for that, a block that finds the pool being changed runs serially
+    juce::SpinLock mWorkerPoolLock;
+    bool mWorkersWanted = false;
+    void updateWorkerPool();
+    struct BlockWork {
+        juce::AudioBuffer<float>* buffer = nullptr;
+        int numChannels = 0;
+        int numSamples = 0;
+        bool bandActive[4] = {};
+        bool shaping[4] = {};
+        bool monoActive = false;
+        bool monoShaping = false;
+    };
+    BlockWork mBlockWork;
+    //filters one band of every channel from the split input into its band buffer, 4 is mono bass
+    void splitBand(int band);
+    //shapes one band through its oversampler, item 4 is the linear path, 5 is mono bass
+    void shapeBand(int item);
+    template <typename Function>
+    void runWorkItems(int numItems, Function& function, bool useWorkers) {
+        if (useWorkers)
+            mWorkerPool.run(numItems, function);
+        else
+            for (int item = 0; item < numItems; item++)
+                function(item);
+    }
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MBDistortionAudioProcessor)   
 };
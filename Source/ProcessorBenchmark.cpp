@@ -0,0 +1,215 @@
+/*
+  ==============================================================================
+
+    ProcessorBenchmark.cpp
+    Created: 20 Oct 2026 10:05:11am
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+//whole processor throughput across host block sizes, serial against multi-threaded
+//and the sub-block data path across sub-block sizes, which picked controlBlockSize
+//only built with MBDISTORTION_BENCHMARKS=1 in the preprocessor definitions
+//for the threading crossover also set MBDISTORTION_MIN_THREADED_BLOCK_SIZE=32, or smaller blocks never share
+//run the "Benchmarks" category with juce::UnitTestRunner, results go to the log
+#ifndef MBDISTORTION_BENCHMARKS
+ #define MBDISTORTION_BENCHMARKS 0
+#endif
+
+#if MBDISTORTION_BENCHMARKS
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+class ProcessorBenchmark : public juce::UnitTest {
+public:
+    ProcessorBenchmark() : juce::UnitTest("Processor", "Benchmarks") {}
+
+    void runTest() override {
+        //every band shaping, so everything that can be shared is
+        for (int factorIndex : { 0, 2, 3 }) {
+            //smallest block size from which threaded wins at every size up
+            int crossover = 0;
+            for (int blockSize : { 32, 64, 128, 256, 512, 1024, 2048, 4096 }) {
+                beginTest(juce::String(1 << factorIndex) + "x, " + juce::String(blockSize) + " samples");
+
+                double serial = timeProcessor(factorIndex, blockSize, false);
+                double threaded = timeProcessor(factorIndex, blockSize, true);
+                if (threaded <= serial)
+                    crossover = 0;
+                else if (crossover == 0)
+                    crossover = blockSize;
+
+                //times faster than realtime, stereo at 48k
+                logMessage("serial " + juce::String(serial, 1) + "x  threaded " + juce::String(threaded, 1)
+                    + "x realtime (" + juce::String(threaded / serial, 2) + ")");
+            }
+            logMessage(juce::String(1 << factorIndex) + "x crossover (" + juce::String(juce::SystemStats::getNumCpus()) + " cpus, threads from "
+                + juce::String(MBDISTORTION_MIN_THREADED_BLOCK_SIZE) + "): "
+                + (crossover > 0 ? juce::String(crossover) + " samples" : juce::String("none")));
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr double audioSeconds = 10.0;
+    static constexpr int numRuns = 3;
+
+    static void setParameter(MBDistortionAudioProcessor& processor, const char* id, float value) {
+        auto* parameter = processor.parameters.getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    double timeProcessor(int factorIndex, int blockSize, bool threaded) {
+        MBDistortionAudioProcessor processor;
+        setParameter(processor, "oversamplingFactor", (float)factorIndex);
+        setParameter(processor, "multiThreading", threaded ? 1.0f : 0.0f);
+        setParameter(processor, "band1type", 2.0f);
+        setParameter(processor, "band2type", 1.0f);
+        setParameter(processor, "band3type", 5.0f);
+        setParameter(processor, "band4type", 4.0f);
+        for (auto* id : { "band1drive", "band2drive", "band3drive", "band4drive" })
+            setParameter(processor, id, 12.0f);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(1);
+        const int numBlocks = (int)(audioSeconds * sampleRate / blockSize);
+
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < numRuns; run++) {
+            double seconds = 0.0;
+            for (int block = 0; block < numBlocks; block++) {
+                for (int channel = 0; channel < 2; channel++) {
+                    auto* data = buffer.getWritePointer(channel);
+                    for (int i = 0; i < blockSize; i++)
+                        data[i] = random.nextFloat() * 0.5f - 0.25f;
+                }
+
+                //only the processor is timed, not the noise
+                auto start = juce::Time::getHighResolutionTicks();
+                processor.processBlock(buffer, midi);
+                seconds += juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+            }
+            best = std::min(best, seconds);
+        }
+
+        processor.releaseResources();
+        return audioSeconds / best;
+    }
+};
+
+static ProcessorBenchmark processorBenchmark;
+
+//split, up, shape, down and sum for 4 stereo bands, chunked like processSubBlock
+//the sizes are run round robin and the median is logged, a single run is too noisy on a shared machine
+class SubBlockBenchmark : public juce::UnitTest {
+public:
+    SubBlockBenchmark() : juce::UnitTest("Sub-block size", "Benchmarks") {}
+
+    void runTest() override {
+        juce::Random random(1);
+        mInput.setSize(numChannels, numSamples);
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int i = 0; i < numSamples; i++)
+                mInput.setSample(channel, i, random.nextFloat() * 0.5f - 0.25f);
+
+        for (int numStages = 1; numStages <= 3; numStages++) {
+            beginTest(juce::String(1 << numStages) + "x stereo");
+
+            std::vector<std::unique_ptr<Chain>> chains;
+            for (int size : sizes)
+                chains.push_back(std::make_unique<Chain>(size, numStages));
+
+            std::vector<std::vector<double>> times(chains.size());
+            for (int round = 0; round < numRounds; round++) {
+                for (size_t i = 0; i < chains.size(); i++) {
+                    auto start = juce::Time::getHighResolutionTicks();
+                    chains[i]->process(mInput);
+                    double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+                    times[i].push_back(seconds * 1.0e9 / numSamples);
+                }
+            }
+
+            //ns per host sample, both channels
+            for (size_t i = 0; i < chains.size(); i++) {
+                auto& runTimes = times[i];
+                std::nth_element(runTimes.begin(), runTimes.begin() + runTimes.size() / 2, runTimes.end());
+                logMessage(juce::String(sizes[i]) + " samples: " + juce::String(runTimes[runTimes.size() / 2], 1) + " ns");
+            }
+        }
+    }
+
+private:
+    static constexpr int numChannels = 2;
+    static constexpr int numSamples = 8192;
+    static constexpr int numRounds = 300;
+    static constexpr int sizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+    struct Chain {
+        Chain(int size, int numStages) : chunkSize(size) {
+            using Type = LinkwitzRileyBank::Type;
+            const Type types[6] = { Type::LowPass, Type::HighPass, Type::LowPass, Type::HighPass, Type::LowPass, Type::HighPass };
+            const double cutoffs[6] = { 200.0, 200.0, 2000.0, 2000.0, 8000.0, 8000.0 };
+            for (int i = 0; i < 6; i++) {
+                filters[i].prepare(types[i], numChannels);
+                filters[i].setSampleRate(48000.0);
+                filters[i].setCutoff(cutoffs[i]);
+            }
+            for (int band = 0; band < 4; band++) {
+                oversamplers[band].prepare(numStages, numChannels, chunkSize);
+                shapers[band].setDistortionType(DistortionTypes::SoftClip);
+                bands[band].setSize(numChannels, chunkSize);
+            }
+            split.resize(numChannels * chunkSize);
+            filtered.resize(numChannels * chunkSize);
+            output.setSize(numChannels, numSamples);
+        }
+
+        void process(const juce::AudioBuffer<float>& input) {
+            const int factor = oversamplers[0].getFactor();
+            for (int start = 0; start + chunkSize <= numSamples; start += chunkSize) {
+                for (int i = 0; i < chunkSize; i++)
+                    for (int channel = 0; channel < numChannels; channel++)
+                        split[i * numChannels + channel] = input.getSample(channel, start + i);
+
+                for (int band = 0; band < 4; band++) {
+                    const int first = band == 0 ? 0 : band * 2 - 1;
+                    filters[first].process(split.data(), filtered.data(), chunkSize, numChannels);
+                    if (band == 1 || band == 2)
+                        filters[first + 1].process(filtered.data(), filtered.data(), chunkSize, numChannels);
+
+                    for (int channel = 0; channel < numChannels; channel++)
+                        for (int i = 0; i < chunkSize; i++)
+                            bands[band].setSample(channel, i, (float)filtered[i * numChannels + channel]);
+
+                    float* oversampled = oversamplers[band].processSamplesUp(bands[band].getArrayOfReadPointers(), numChannels, chunkSize);
+                    shapers[band].processBlock(oversampled, chunkSize * factor, numChannels);
+                    oversamplers[band].processSamplesDown(bands[band].getArrayOfWritePointers(), numChannels, chunkSize);
+                }
+
+                for (int channel = 0; channel < numChannels; channel++) {
+                    output.copyFrom(channel, start, bands[0], channel, 0, chunkSize);
+                    for (int band = 1; band < 4; band++)
+                        output.addFrom(channel, start, bands[band], channel, 0, chunkSize);
+                }
+            }
+        }
+
+        int chunkSize;
+        LinkwitzRileyBank filters[6];
+        HalfbandOversampler oversamplers[4];
+        DistortionProcessor shapers[4];
+        std::vector<double> split, filtered;
+        juce::AudioBuffer<float> bands[4];
+        juce::AudioBuffer<float> output;
+    };
+
+    juce::AudioBuffer<float> mInput;
+};
+
+static SubBlockBenchmark subBlockBenchmark;
+
+#endif
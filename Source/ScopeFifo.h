@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    ScopeFifo.h
+    Created: 19 Oct 2026 10:18:47pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+//single producer (audio thread), single consumer (message thread) sample fifo for the scope
+//the storage is allocated once and never resized, so nothing the reader holds can move
+//positions only ever count up and are masked into the power of two storage
+//what doesn't fit while the reader is behind is dropped, the audio thread never waits
+//nothing is written while no reader is attached, so a new one doesn't start on stale audio
+class ScopeFifo {
+public:
+    static constexpr int capacity = 1 << 15; //> 100ms at 192k
+
+    ScopeFifo() : mBuffer(new float[capacity]()) {}
+
+    //message thread, the reader attaches while the scope is on screen
+    void setActive(bool shouldBeActive) {
+        if (shouldBeActive) {
+            //the read side is ours, skip whatever was left from the last time it was open
+            mReadPosition.store(mWritePosition.load(std::memory_order_acquire), std::memory_order_release);
+        }
+        mActive.store(shouldBeActive, std::memory_order_relaxed);
+    }
+
+    //audio thread
+    void write(const float* data, int numSamples) {
+        if (!mActive.load(std::memory_order_relaxed))
+            return;
+        std::uint32_t writePosition = mWritePosition.load(std::memory_order_relaxed);
+        std::uint32_t readPosition = mReadPosition.load(std::memory_order_acquire);
+        int numFree = capacity - (int)(writePosition - readPosition);
+        numSamples = std::min(numSamples, numFree);
+        if (numSamples <= 0)
+            return;
+
+        int start = (int)(writePosition & mask);
+        int firstPart = std::min(numSamples, capacity - start);
+        std::memcpy(mBuffer.get() + start, data, sizeof(float) * (size_t)firstPart);
+        std::memcpy(mBuffer.get(), data + firstPart, sizeof(float) * (size_t)(numSamples - firstPart));
+        mWritePosition.store(writePosition + (std::uint32_t)numSamples, std::memory_order_release);
+    }
+
+    //message thread, returns how many samples were read
+    int read(float* data, int maxSamples) {
+        std::uint32_t readPosition = mReadPosition.load(std::memory_order_relaxed);
+        std::uint32_t writePosition = mWritePosition.load(std::memory_order_acquire);
+        int numSamples = std::min(maxSamples, (int)(writePosition - readPosition));
+        if (numSamples <= 0)
+            return 0;
+
+        int start = (int)(readPosition & mask);
+        int firstPart = std::min(numSamples, capacity - start);
+        std::memcpy(data, mBuffer.get() + start, sizeof(float) * (size_t)firstPart);
+        std::memcpy(data + firstPart, mBuffer.get(), sizeof(float) * (size_t)(numSamples - firstPart));
+        mReadPosition.store(readPosition + (std::uint32_t)numSamples, std::memory_order_release);
+        return numSamples;
+    }
+
+    //how many samples one scope view covers, set from prepareToPlay
+    void setViewLength(int numSamples) { mViewLength.store(std::clamp(numSamples, 1, capacity), std::memory_order_relaxed); }
+    int getViewLength() const { return mViewLength.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr std::uint32_t mask = capacity - 1;
+    std::unique_ptr<float[]> mBuffer;
+    std::atomic<std::uint32_t> mWritePosition{ 0 };
+    std::atomic<std::uint32_t> mReadPosition{ 0 };
+    std::atomic<int> mViewLength{ 4410 };
+    std::atomic<bool> mActive{ false };
+};
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    ScratchArena.h
+    Created: 19 Oct 2026 5:22:40pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+//one block of memory that every intermediate buffer of the engine is carved from
+//slices start on a cache line, so neighbouring buffers never share one
+//
+//layout runs twice: once to measure (take() returns nullptr), once more after allocate()
+//    arena.beginLayout(); layout(); arena.allocate(); layout();
+class ScratchArena {
+public:
+    static constexpr std::size_t alignment = 64;
+
+    //starts measuring, the memory from the last allocate() stays until the next one
+    void beginLayout() {
+        mMeasuring = true;
+        mUsed = 0;
+    }
+
+    //allocates what the layout asked for, zeroed, and rewinds for the carving pass
+    void allocate() {
+        if (mUsed > mCapacity) {
+            mStorage.reset(new char[mUsed + alignment]);
+            mCapacity = mUsed;
+        }
+        auto address = reinterpret_cast<std::uintptr_t>(mStorage.get());
+        mBase = mStorage.get() + (alignment - address % alignment) % alignment;
+        std::fill(mBase, mBase + mCapacity, 0);
+
+        mMeasuring = false;
+        mUsed = 0;
+    }
+
+    template <typename T>
+    T* take(std::size_t count) {
+        std::size_t offset = mUsed;
+        mUsed += (count * sizeof(T) + alignment - 1) / alignment * alignment;
+        return mMeasuring ? nullptr : reinterpret_cast<T*>(mBase + offset);
+    }
+
+    std::size_t getSizeInBytes() const { return mCapacity; }
+
+private:
+    std::unique_ptr<char[]> mStorage;
+    char* mBase = nullptr;
+    std::size_t mCapacity = 0;
+    std::size_t mUsed = 0;
+    bool mMeasuring = true;
+};
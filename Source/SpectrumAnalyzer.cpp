@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyzer.cpp
+    Created: 19 Oct 2026 11:02:31pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#include "SpectrumAnalyzer.h"
+#include <algorithm>
+#include <cmath>
+
+SpectrumAnalyzer::SpectrumAnalyzer() : juce::Thread("Spectrum Analyzer") {}
+
+SpectrumAnalyzer::~SpectrumAnalyzer() {
+    mActive.store(false, std::memory_order_relaxed);
+    stopThread(1000);
+}
+
+void SpectrumAnalyzer::setActive(bool shouldBeActive) {
+    if (shouldBeActive == isActive())
+        return;
+
+    if (shouldBeActive) {
+        //the thread isn't running so the read side is ours, the fifos skip whatever was left from last time
+        for (auto& fifo : mFifos)
+            fifo.setActive(true);
+        for (auto& stream : mStreams)
+            stream.middle.store(stream.middle.load(std::memory_order_relaxed) & 3, std::memory_order_relaxed);
+
+        //start from silence
+        mConfiguredRate = 0.0;
+        mActive.store(true, std::memory_order_relaxed);
+        startThread();
+    }
+    else {
+        mActive.store(false, std::memory_order_relaxed);
+        stopThread(1000);
+        for (auto& fifo : mFifos)
+            fifo.setActive(false);
+    }
+}
+
+bool SpectrumAnalyzer::getLatest(int band, bool postShaper, Spectrum& spectrum) {
+    Stream& stream = mStreams[band * 2 + (postShaper ? 1 : 0)];
+    if ((stream.middle.load(std::memory_order_relaxed) & 4) == 0)
+        return false;
+
+    stream.front = stream.middle.exchange(stream.front, std::memory_order_acq_rel) & 3;
+    spectrum = stream.buffers[stream.front];
+    return true;
+}
+
+void SpectrumAnalyzer::run() {
+    double lastTime = juce::Time::getMillisecondCounterHiRes();
+    while (!threadShouldExit()) {
+        double sampleRate = mSampleRate.load(std::memory_order_relaxed);
+        if (sampleRate != mConfiguredRate)
+            configure(sampleRate);
+
+        double now = juce::Time::getMillisecondCounterHiRes();
+        double seconds = (now - lastTime) * 0.001;
+        lastTime = now;
+
+        for (int stream = 0; stream < numStreams; stream++) {
+            analyse(stream);
+            if (applyBallistics(stream, seconds))
+                publish(stream);
+        }
+
+        wait(updateIntervalMs);
+    }
+}
+
+void SpectrumAnalyzer::configure(double sampleRate) {
+    mConfiguredRate = sampleRate;
+
+    //2048 at 44.1/48k, about 23Hz per bin at every rate
+    int order = sampleRate > 132000.0 ? 13 : sampleRate > 66000.0 ? 12 : 11;
+    mFftSize = 1 << order;
+    mHopSize = mFftSize / 4;
+    mFft = std::make_unique<juce::dsp::FFT>(order);
+
+    mWindow.assign(mFftSize, 0.0f);
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(mWindow.data(), (size_t)mFftSize, juce::dsp::WindowingFunction<float>::hann, false);
+    mFftData.assign(2 * mFftSize, 0.0f);
+    mReadBuffer.assign(mHopSize, 0.0f);
+
+    //log spaced display bins, low ones are narrower than an fft bin and get interpolated instead
+    const double top = std::min((double)maxFrequency, sampleRate * 0.5);
+    const double binsPerHz = mFftSize / sampleRate;
+    const int lastBin = mFftSize / 2;
+    for (int bin = 0; bin < numBins; bin++) {
+        double low = minFrequency * std::pow(top / minFrequency, bin / (double)numBins);
+        double high = minFrequency * std::pow(top / minFrequency, (bin + 1) / (double)numBins);
+        mBinStart[bin] = std::min((int)std::ceil(low * binsPerHz), lastBin);
+        mBinEnd[bin] = std::min((int)std::ceil(high * binsPerHz), lastBin + 1);
+        mBinPosition[bin] = (float)std::min(std::sqrt(low * high) * binsPerHz, (double)lastBin);
+    }
+
+    for (auto& stream : mStreams) {
+        stream.history.assign(mFftSize, 0.0f);
+        stream.samplesSinceFrame = 0;
+        stream.secondsSinceFrame = frameTimeoutSeconds;
+        stream.frame.fill(floorDb);
+        stream.level.fill(floorDb);
+        stream.peak.fill(floorDb);
+        stream.peakAge.fill(0.0);
+        stream.silent = false;
+    }
+}
+
+void SpectrumAnalyzer::analyse(int streamIndex) {
+    Stream& stream = mStreams[streamIndex];
+    bool newFrame = false;
+
+    for (;;) {
+        int numRead = mFifos[streamIndex].read(mReadBuffer.data(), mHopSize - stream.samplesSinceFrame);
+        if (numRead == 0)
+            break;
+
+        std::copy(stream.history.begin() + numRead, stream.history.end(), stream.history.begin());
+        std::copy(mReadBuffer.begin(), mReadBuffer.begin() + numRead, stream.history.end() - numRead);
+        stream.samplesSinceFrame += numRead;
+        if (stream.samplesSinceFrame < mHopSize)
+            break;
+        stream.samplesSinceFrame = 0;
+
+        juce::FloatVectorOperations::multiply(mFftData.data(), stream.history.data(), mWindow.data(), mFftSize);
+        std::fill(mFftData.begin() + mFftSize, mFftData.end(), 0.0f);
+        mFft->performFrequencyOnlyForwardTransform(mFftData.data(), true);
+
+        //hann halves a sine's peak and the fft spreads it over both halves, so 4 / size reads a full scale sine as 0dB
+        const float scale = 4.0f / mFftSize;
+        if (!newFrame) {
+            stream.frame.fill(floorDb);
+            newFrame = true;
+        }
+        for (int bin = 0; bin < numBins; bin++) {
+            float magnitude;
+            if (mBinEnd[bin] > mBinStart[bin]) {
+                magnitude = *std::max_element(mFftData.begin() + mBinStart[bin], mFftData.begin() + mBinEnd[bin]);
+            }
+            else {
+                int index = (int)mBinPosition[bin];
+                float fraction = mBinPosition[bin] - index;
+                int next = std::min(index + 1, mFftSize / 2);
+                magnitude = mFftData[index] + (mFftData[next] - mFftData[index]) * fraction;
+            }
+            float level = juce::Decibels::gainToDecibels(magnitude * scale, floorDb);
+            stream.frame[bin] = std::max(stream.frame[bin], level);
+        }
+    }
+
+    if (newFrame)
+        stream.secondsSinceFrame = 0.0;
+}
+
+bool SpectrumAnalyzer::applyBallistics(int streamIndex, double seconds) {
+    Stream& stream = mStreams[streamIndex];
+
+    //a tick without a frame keeps the last one, a band that stopped sending falls away
+    stream.secondsSinceFrame += seconds;
+    if (stream.secondsSinceFrame > frameTimeoutSeconds)
+        stream.frame.fill(floorDb);
+
+    const float release = (float)(releaseDbPerSecond * seconds);
+    const float fall = (float)(peakFallDbPerSecond * seconds);
+    bool silent = true;
+    for (int bin = 0; bin < numBins; bin++) {
+        float target = stream.frame[bin];
+        float& level = stream.level[bin];
+        level = target > level ? target : std::max(target, level - release);
+
+        float& peak = stream.peak[bin];
+        if (level >= peak) {
+            peak = level;
+            stream.peakAge[bin] = 0.0;
+        }
+        else if ((stream.peakAge[bin] += seconds) > peakHoldSeconds) {
+            peak = std::max(level, peak - fall);
+        }
+        silent = silent && peak <= floorDb;
+    }
+
+    //a silent stream only needs publishing once
+    bool changed = !(silent && stream.silent);
+    stream.silent = silent;
+    return changed;
+}
+
+void SpectrumAnalyzer::publish(int streamIndex) {
+    Stream& stream = mStreams[streamIndex];
+    Spectrum& spectrum = stream.buffers[stream.back];
+    spectrum.level = stream.level;
+    spectrum.peak = stream.peak;
+    stream.back = stream.middle.exchange(stream.back | 4, std::memory_order_acq_rel) & 3;
+}
@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyzer.h
+    Created: 19 Oct 2026 11:02:15pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include "ScopeFifo.h"
+
+//spectrum of every band before and after its shaper, so the generated harmonics can be seen
+//the audio thread only copies samples into one fifo per stream, and only while the editor is open
+//a background thread does the overlapped ffts, log frequency binning and ballistics
+//and publishes ready to draw levels through a triple buffer per stream
+class SpectrumAnalyzer : private juce::Thread {
+public:
+    static constexpr int numBands = 4;
+    static constexpr int numStreams = numBands * 2;
+    static constexpr int numBins = 256;
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float maxFrequency = 20000.0f;
+    static constexpr float floorDb = -100.0f;
+
+    struct Spectrum {
+        std::array<float, numBins> level;
+        std::array<float, numBins> peak;
+    };
+
+    SpectrumAnalyzer();
+    ~SpectrumAnalyzer() override;
+
+    //prepareToPlay, safe while the thread runs, it picks the rate up itself
+    void setSampleRate(double sampleRate) { mSampleRate.store(sampleRate, std::memory_order_relaxed); }
+
+    //message thread, the editor switches it on while it's open
+    void setActive(bool shouldBeActive);
+    //audio thread, nothing needs pushing while this is false
+    bool isActive() const { return mActive.load(std::memory_order_relaxed); }
+    void push(int band, bool postShaper, const float* data, int numSamples) {
+        mFifos[band * 2 + (postShaper ? 1 : 0)].write(data, numSamples);
+    }
+
+    //message thread, false when nothing new has been published since the last call
+    bool getLatest(int band, bool postShaper, Spectrum& spectrum);
+
+private:
+    void run() override;
+    //(re)builds every size dependent table for this rate
+    void configure(double sampleRate);
+    void analyse(int stream);
+    //false when the stream is still silent, nothing new to publish
+    bool applyBallistics(int stream, double seconds);
+    void publish(int stream);
+
+    std::atomic<bool> mActive{ false };
+    std::atomic<double> mSampleRate{ 44100.0 };
+    ScopeFifo mFifos[numStreams];
+
+    //analysis thread only
+    //fft size follows the rate so the bin spacing stays about the same, 75% overlap
+    double mConfiguredRate = 0.0;
+    int mFftSize = 0;
+    int mHopSize = 0;
+    std::unique_ptr<juce::dsp::FFT> mFft;
+    std::vector<float> mWindow;
+    std::vector<float> mFftData;
+    std::vector<float> mReadBuffer;
+    //fft bins [binStart, binEnd) fall in each display bin, or binEnd <= binStart to interpolate at 'binPosition'
+    std::array<int, numBins> mBinStart{}, mBinEnd{};
+    std::array<float, numBins> mBinPosition{};
+
+    struct Stream {
+        std::vector<float> history;  //last fftSize samples, oldest first
+        int samplesSinceFrame = 0;
+        double secondsSinceFrame = 0.0;
+        std::array<float, numBins> frame;  //loudest frame of the last tick that had one
+        std::array<float, numBins> level;
+        std::array<float, numBins> peak;
+        std::array<double, numBins> peakAge;
+        bool silent = false;
+
+        //triple buffer, the analysis thread owns 'back', the reader owns 'front'
+        //'middle' holds the index of the third buffer, bit 2 set when it's newer than the reader's
+        Spectrum buffers[3];
+        int back = 0;
+        std::atomic<int> middle{ 1 };
+        int front = 2;
+    };
+    Stream mStreams[numStreams];
+
+    //ballistics
+    static constexpr float releaseDbPerSecond = 60.0f;
+    static constexpr double peakHoldSeconds = 1.0;
+    static constexpr float peakFallDbPerSecond = 20.0f;
+    static constexpr double frameTimeoutSeconds = 0.1;
+    static constexpr int updateIntervalMs = 15;
+};
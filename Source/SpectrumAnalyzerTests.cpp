@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyzerTests.cpp
+    Created: 20 Oct 2026 4:12:37pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+//built with JUCE_UNIT_TESTS=1, run the "MBDistortion" category with juce::UnitTestRunner
+#include <JuceHeader.h>
+
+#if JUCE_UNIT_TESTS
+
+#include "SpectrumAnalyzer.h"
+
+class SpectrumAnalyzerTests : public juce::UnitTest {
+public:
+    SpectrumAnalyzerTests() : juce::UnitTest("Spectrum analyzer", "MBDistortion") {}
+
+    void runTest() override {
+        beginTest("pushed audio is analysed while active");
+        {
+            SpectrumAnalyzer analyzer;
+            analyzer.setSampleRate(sampleRate);
+            analyzer.setActive(true);
+            pushSine(analyzer);
+            expectGreaterThan(getPeakLevel(analyzer), -6.0f);
+            analyzer.setActive(false);
+        }
+
+        beginTest("audio pushed while inactive is dropped");
+        {
+            SpectrumAnalyzer analyzer;
+            analyzer.setSampleRate(sampleRate);
+            pushSine(analyzer);
+            analyzer.setActive(true);
+            expectLessOrEqual(getPeakLevel(analyzer), SpectrumAnalyzer::floorDb);
+            analyzer.setActive(false);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr float frequency = 1000.0f;
+    static constexpr int band = 1;
+
+    void pushSine(SpectrumAnalyzer& analyzer) {
+        std::vector<float> sine(8192);
+        for (size_t i = 0; i < sine.size(); i++)
+            sine[i] = (float)std::sin(juce::MathConstants<double>::twoPi * frequency * (double)i / sampleRate);
+        analyzer.push(band, true, sine.data(), (int)sine.size());
+    }
+
+    //highest peak published around the sine's frequency
+    //the analysis thread publishes every few ms, a second is plenty
+    static float getPeakLevel(SpectrumAnalyzer& analyzer) {
+        float level = SpectrumAnalyzer::floorDb;
+        SpectrumAnalyzer::Spectrum spectrum;
+        for (int attempt = 0; attempt < 100; attempt++) {
+            while (analyzer.getLatest(band, true, spectrum))
+                level = std::max(level, levelAt(spectrum.peak, frequency));
+            juce::Thread::sleep(10);
+        }
+        return level;
+    }
+
+    //loudest display bin within half an octave of 'hz'
+    static float levelAt(const std::array<float, SpectrumAnalyzer::numBins>& levels, float hz) {
+        float level = SpectrumAnalyzer::floorDb;
+        const float octaves = std::log2(SpectrumAnalyzer::maxFrequency / SpectrumAnalyzer::minFrequency);
+        for (int bin = 0; bin < SpectrumAnalyzer::numBins; bin++) {
+            float binFrequency = SpectrumAnalyzer::minFrequency * std::pow(2.0f, octaves * (bin + 0.5f) / SpectrumAnalyzer::numBins);
+            if (std::abs(std::log2(binFrequency / hz)) < 0.5f)
+                level = std::max(level, levels[bin]);
+        }
+        return level;
+    }
+};
+
+static SpectrumAnalyzerTests spectrumAnalyzerTests;
+
+#endif
@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    SpectrumComponent.h
+    Created: 19 Oct 2026 11:40:08pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumAnalyzer.h"
+
+//one band's spectrum going into its shaper (line) and coming out of it (filled, with its peak hold)
+//everything is analysed on the analyzer's thread, this only draws what it published
+//click to move on to the next band
+class SpectrumComponent : public juce::Component,
+    private juce::Timer
+{
+public:
+    SpectrumComponent(SpectrumAnalyzer& analyzerToUse)
+        : analyzer(analyzerToUse)
+    {
+        pre.level.fill(SpectrumAnalyzer::floorDb);
+        pre.peak.fill(SpectrumAnalyzer::floorDb);
+        post = pre;
+
+        //fills its whole area, so its repaints never reach the editor behind it
+        setOpaque(true);
+        startTimerHz(30);
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        g.fillAll(juce::Colour(0xff323940));
+
+        float width = (float)getWidth();
+        float height = (float)getHeight();
+
+        //decades
+        g.setColour(juce::Colour(0xff3d454d));
+        for (float frequency : { 100.0f, 1000.0f, 10000.0f }) {
+            float x = width * std::log(frequency / SpectrumAnalyzer::minFrequency)
+                / std::log(SpectrumAnalyzer::maxFrequency / SpectrumAnalyzer::minFrequency);
+            g.drawLine(x, 0.0f, x, height);
+        }
+
+        //display bins are log spaced already, so they sit evenly across the width
+        auto toY = [height](float db) { return height * juce::jlimit(0.0f, 1.0f, db / rangeDb); };
+        const float binWidth = width / SpectrumAnalyzer::numBins;
+
+        juce::Path output, input, peak;
+        output.preallocateSpace(SpectrumAnalyzer::numBins * 3 + 9);
+        input.preallocateSpace(SpectrumAnalyzer::numBins * 3 + 3);
+        peak.preallocateSpace(SpectrumAnalyzer::numBins * 3 + 3);
+        output.startNewSubPath(0.0f, height);
+        for (int bin = 0; bin < SpectrumAnalyzer::numBins; bin++) {
+            float x = (bin + 0.5f) * binWidth;
+            output.lineTo(x, toY(post.level[bin]));
+            if (bin == 0) {
+                input.startNewSubPath(x, toY(pre.level[bin]));
+                peak.startNewSubPath(x, toY(post.peak[bin]));
+            }
+            else {
+                input.lineTo(x, toY(pre.level[bin]));
+                peak.lineTo(x, toY(post.peak[bin]));
+            }
+        }
+        output.lineTo(width, height);
+        output.closeSubPath();
+
+        g.setColour(juce::Colour(0xff82585b));
+        g.fillPath(output);
+        g.setColour(juce::Colour(0xff82585b).brighter(0.4f));
+        g.strokePath(peak, juce::PathStrokeType(1.0f));
+        g.setColour(juce::Colour(0xffd8d8d8).withAlpha(0.6f));
+        g.strokePath(input, juce::PathStrokeType(1.5f));
+
+        g.setColour(juce::Colour(0xffd8d8d8));
+        g.setFont(12.0f);
+        g.drawText("Band " + juce::String(band + 1), getLocalBounds().reduced(4), juce::Justification::topLeft);
+    }
+
+    void mouseDown(const juce::MouseEvent&) override
+    {
+        band = (band + 1) % SpectrumAnalyzer::numBands;
+        //the other band's last spectrum is picked up on the next tick
+        pre.level.fill(SpectrumAnalyzer::floorDb);
+        pre.peak.fill(SpectrumAnalyzer::floorDb);
+        post = pre;
+        repaint();
+    }
+
+private:
+    void timerCallback() override
+    {
+        //both are read every tick so neither keeps a stale one waiting
+        bool newInput = analyzer.getLatest(band, false, pre);
+        bool newOutput = analyzer.getLatest(band, true, post);
+        if (newInput || newOutput)
+            repaint();
+    }
+
+    //bottom of the display
+    static constexpr float rangeDb = -90.0f;
+
+    SpectrumAnalyzer& analyzer;
+    int band = 0;
+    SpectrumAnalyzer::Spectrum pre, post;
+};
@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+    TruePeakLimiter.cpp
+    Created: 19 Oct 2026 9:36:25pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#define _USE_MATH_DEFINES
+
+#include "TruePeakLimiter.h"
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    //zeroth order modified bessel function, for the kaiser window
+    double besselI0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+}
+
+void TruePeakLimiter::prepare(double sampleRate, int numChannels) {
+    //interpolation kernel
+    //tap j of phase k sits (j - middle - k / 4) samples from the point being interpolated
+    const int middle = tapsPerPhase / 2 - 1;
+    const double beta = 6.0;
+    const double halfSpan = tapsPerPhase / 2.0;
+    mInterpolationBound = 1.0f;
+    for (int phase = 0; phase < oversampling - 1; phase++) {
+        double offset = (phase + 1) / (double)oversampling;
+        double sum = 0.0;
+        double coefs[tapsPerPhase];
+        for (int tap = 0; tap < tapsPerPhase; tap++) {
+            double x = tap - middle - offset;
+            double sinc = std::sin(M_PI * x) / (M_PI * x);
+            double position = x / halfSpan;
+            double window = std::abs(position) < 1.0 ? besselI0(beta * std::sqrt(1.0 - position * position)) / besselI0(beta) : 0.0;
+            coefs[tap] = sinc * window;
+            sum += coefs[tap];
+        }
+
+        //unity at dc
+        float absSum = 0.0f;
+        for (int tap = 0; tap < tapsPerPhase; tap++) {
+            mPhaseCoefs[phase][tap] = (float)(coefs[tap] / sum);
+            absSum += std::abs(mPhaseCoefs[phase][tap]);
+        }
+        mInterpolationBound = std::max(mInterpolationBound, absSum);
+    }
+
+    //half the taps to see the future of the interpolated point, then the look ahead
+    mLookahead = std::max(8, (int)std::round(lookaheadSeconds * sampleRate));
+    mLatency = tapsPerPhase / 2 + mLookahead;
+
+    mRingSize = std::max(mLatency + 1, tapsPerPhase);
+    mHistory.assign(numChannels, std::vector<float>(2 * mRingSize, 0.0f));
+
+    mMinValues.assign(mLookahead + 1, 1.0f);
+    mMinIndices.assign(mLookahead + 1, 0);
+    mAverageWindow.assign(mLookahead + 1, 1.0f);
+    mGains.assign(gainChunkSize, 1.0f);
+    mReleaseCoef = (float)(1.0 - std::exp(-1.0 / (releaseSeconds * sampleRate)));
+
+    reset();
+}
+
+void TruePeakLimiter::reset() {
+    for (auto& history : mHistory)
+        std::fill(history.begin(), history.end(), 0.0f);
+    mWritePosition = 0;
+    mPreviousPeak = 0.0f;
+    mLoudSamples = 0;
+
+    mMinHead = 0;
+    mMinCount = 0;
+    mSampleIndex = 0;
+    mReleased = 1.0f;
+    std::fill(mAverageWindow.begin(), mAverageWindow.end(), 1.0f);
+    mAveragePosition = 0;
+    mAverageSum = (double)mAverageWindow.size();
+}
+
+void TruePeakLimiter::process(float* const* channels, int numChannels, int numSamples) {
+    numChannels = std::min(numChannels, (int)mHistory.size());
+    const int middle = tapsPerPhase / 2 - 1;
+
+    for (int start = 0; start < numSamples; start += gainChunkSize) {
+        int chunkSize = std::min(gainChunkSize, numSamples - start);
+
+        for (int i = 0; i < chunkSize; i++) {
+            float framePeak = 0.0f;
+            for (int channel = 0; channel < numChannels; channel++) {
+                float sample = channels[channel][start + i];
+                mHistory[channel][mWritePosition] = sample;
+                mHistory[channel][mWritePosition + mRingSize] = sample;
+                framePeak = std::max(framePeak, std::abs(sample));
+            }
+
+            //the interpolator can't overshoot its taps' peak by more than its bound
+            //so it only runs while one sample loud enough is still in the taps, whatever the block size
+            if (framePeak * mInterpolationBound >= mCeiling)
+                mLoudSamples = tapsPerPhase;
+            bool interpolate = mLoudSamples > 0 && !mBypassed;
+            mLoudSamples = std::max(mLoudSamples - 1, 0);
+
+            float peak = 0.0f;
+            for (int channel = 0; channel < numChannels; channel++) {
+                const float* ring = mHistory[channel].data();
+                if (interpolate) {
+                    //newest tapsPerPhase samples, the point being checked is 'middle'
+                    const float* taps = ring + mWritePosition + mRingSize - (tapsPerPhase - 1);
+                    peak = std::max(peak, std::abs(taps[middle]));
+                    for (int phase = 0; phase < oversampling - 1; phase++) {
+                        float interpolated = 0.0f;
+                        for (int tap = 0; tap < tapsPerPhase; tap++)
+                            interpolated += mPhaseCoefs[phase][tap] * taps[tap];
+                        peak = std::max(peak, std::abs(interpolated));
+                    }
+                }
+
+                channels[channel][start + i] = ring[mWritePosition + mRingSize - mLatency];
+            }
+            mWritePosition = mWritePosition + 1 == mRingSize ? 0 : mWritePosition + 1;
+
+            //a peak between two samples needs both of them turned down
+            float required = std::max(peak, mPreviousPeak);
+            mPreviousPeak = peak;
+            mGains[i] = nextGain(required > mCeiling ? mCeiling / required : 1.0f);
+        }
+
+        for (int channel = 0; channel < numChannels; channel++)
+            juce::FloatVectorOperations::multiply(channels[channel] + start, mGains.data(), chunkSize);
+    }
+}
+
+float TruePeakLimiter::nextGain(float target) {
+    const int window = mLookahead + 1;
+
+    //sliding minimum, a monotonic queue of (value, index)
+    while (mMinCount > 0 && mMinValues[(mMinHead + mMinCount - 1) % window] >= target)
+        mMinCount--;
+    int back = (mMinHead + mMinCount) % window;
+    mMinValues[back] = target;
+    mMinIndices[back] = mSampleIndex;
+    mMinCount++;
+    while (mMinIndices[mMinHead] <= mSampleIndex - window) {
+        mMinHead = (mMinHead + 1) % window;
+        mMinCount--;
+    }
+    float held = mMinValues[mMinHead];
+    mSampleIndex++;
+
+    //straight down, slowly back up
+    mReleased = held < mReleased ? held : mReleased + (held - mReleased) * mReleaseCoef;
+
+    //moving average, summed again from scratch every lap so rounding can't build up
+    mAverageSum += mReleased - mAverageWindow[mAveragePosition];
+    mAverageWindow[mAveragePosition] = mReleased;
+    if (++mAveragePosition == window) {
+        mAveragePosition = 0;
+        mAverageSum = 0.0;
+        for (float value : mAverageWindow)
+            mAverageSum += value;
+    }
+    return (float)(mAverageSum / window);
+}
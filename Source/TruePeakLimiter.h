@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    TruePeakLimiter.h
+    Created: 19 Oct 2026 9:36:12pm
+    Author:  maxbu
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+//safety limiter for the output, keeps the true (inter-sample) peak under the ceiling
+//peaks between samples come from a 4x polyphase interpolator that only computes the 3 in between phases
+//the gain is already down when a peak comes out, the look ahead is the latency
+//every channel gets the same gain so the image doesn't move
+class TruePeakLimiter {
+public:
+    //not realtime safe, call from prepareToPlay
+    void prepare(double sampleRate, int numChannels);
+    void reset();
+
+    //linear gain, 1 = 0dBTP
+    //a lower ceiling may make the samples already in the taps loud enough to interpolate
+    void setCeiling(float ceiling) {
+        if (ceiling < mCeiling)
+            mLoudSamples = tapsPerPhase;
+        mCeiling = ceiling;
+    }
+    //bypassed the signal is only delayed, the gain releases back to unity so there's no click
+    void setBypassed(bool shouldBeBypassed) { mBypassed = shouldBeBypassed; }
+    int getLatencyInSamples() const { return mLatency; }
+
+    //delays and limits the channels in place
+    void process(float* const* channels, int numChannels, int numSamples);
+
+private:
+    static constexpr int oversampling = 4;
+    static constexpr int tapsPerPhase = 12;
+    static constexpr double lookaheadSeconds = 0.001;
+    static constexpr double releaseSeconds = 0.05;
+    //gains are worked out per sample, then applied to every channel in one go
+    static constexpr int gainChunkSize = 64;
+
+    //windowed sinc, phase k interpolates k / 4 of the way past the middle tap
+    float mPhaseCoefs[oversampling - 1][tapsPerPhase] = {};
+    //largest overshoot the interpolator can produce, below ceiling / bound nothing needs interpolating
+    float mInterpolationBound = 1.0f;
+    //samples left until the last one above ceiling / bound has gone through every tap
+    int mLoudSamples = 0;
+
+    //per channel ring, written twice so the newest taps and the delayed sample are always contiguous
+    std::vector<std::vector<float>> mHistory;
+    int mRingSize = 0;
+    int mWritePosition = 0;
+
+    int mLookahead = 0;
+    int mLatency = 0;
+    float mCeiling = 1.0f;
+    bool mBypassed = false;
+    float mPreviousPeak = 0.0f;
+
+    //gain pipeline: sliding minimum over the look ahead, release, then a moving average over the look ahead
+    //every value in the average window is at most the gain its peak needs, so the peak never gets through
+    float nextGain(float target);
+    std::vector<float> mMinValues;
+    std::vector<long long> mMinIndices;
+    int mMinHead = 0;
+    int mMinCount = 0;
+    long long mSampleIndex = 0;
+    float mReleased = 1.0f;
+    float mReleaseCoef = 0.0f;
+    std::vector<float> mAverageWindow;
+    int mAveragePosition = 0;
+    double mAverageSum = 0.0;
+    std::vector<float> mGains;
+};